@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "animation.h"
+#include "client.h"
+#include "config.h"
+#include "screen.h"
+#include "state.h"
+#include "utils.h"
+
+#define DEFAULT_REFRESH_RATE 60.0
+
+double animation_interval(state_t *);
+double animation_now(void);
+
+void
+animation_cancel(state_t *state, client_t *client)
+{
+	animation_t *animation;
+
+	TAILQ_FOREACH(animation, &state->animations, entry) {
+		if (animation->client == client) {
+			TAILQ_REMOVE(&state->animations, animation, entry);
+			free(animation);
+			return;
+		}
+	}
+}
+
+void
+animation_free(state_t *state)
+{
+	animation_t *animation;
+
+	while ((animation = TAILQ_FIRST(&state->animations)) != NULL) {
+		TAILQ_REMOVE(&state->animations, animation, entry);
+		free(animation);
+	}
+}
+
+double
+animation_interval(state_t *state)
+{
+	double rate = 0;
+	screen_t *screen;
+
+	TAILQ_FOREACH(screen, &state->screens, entry) {
+		if (screen->refresh_rate > rate) {
+			rate = screen->refresh_rate;
+		}
+	}
+
+	if (rate <= 0) {
+		rate = DEFAULT_REFRESH_RATE;
+	}
+
+	return 1.0 / rate;
+}
+
+double
+animation_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+Bool
+animation_start(state_t *state, client_t *client, geometry_t from)
+{
+	animation_t *animation;
+
+	if ((state->config->transition_duration <= 0) || !client->mapped || (client->flags & CLIENT_HIDDEN)) {
+		animation_cancel(state, client);
+		return False;
+	}
+
+	TAILQ_FOREACH(animation, &state->animations, entry) {
+		if (animation->client == client) {
+			break;
+		}
+	}
+
+	if (animation) {
+		from = animation->current;
+	} else {
+		animation = calloc(1, sizeof(animation_t));
+		animation->client = client;
+		TAILQ_INSERT_TAIL(&state->animations, animation, entry);
+	}
+
+	if (!memcmp(&from, &client->geometry, sizeof(geometry_t))) {
+		TAILQ_REMOVE(&state->animations, animation, entry);
+		free(animation);
+		return False;
+	}
+
+	if (TAILQ_FIRST(&state->animations) == animation) {
+		state->next_frame = 0;
+	}
+
+	animation->from = from;
+	animation->to = client->geometry;
+	animation->current = from;
+	animation->start = animation_now();
+
+	return True;
+}
+
+void
+animation_tick(state_t *state)
+{
+	animation_t *animation, *next;
+	client_t *client;
+	double now, progress;
+
+	if (TAILQ_EMPTY(&state->animations)) {
+		return;
+	}
+
+	now = animation_now();
+	if (now < state->next_frame) {
+		return;
+	}
+
+	/*
+	 * The next frame is scheduled from the current time rather than from the
+	 * previous deadline, so frames missed under load are dropped instead of
+	 * being replayed back to back.
+	 */
+	state->next_frame = now + animation_interval(state);
+
+	TAILQ_FOREACH_SAFE(animation, &state->animations, entry, next) {
+		client = animation->client;
+
+		progress = (now - animation->start) / state->config->transition_duration;
+		if (progress >= 1.0) {
+			TAILQ_REMOVE(&state->animations, animation, entry);
+			free(animation);
+
+			client_move_resize(state, client, False);
+			continue;
+		}
+
+		progress = 1.0 - (1.0 - progress) * (1.0 - progress) * (1.0 - progress);
+
+		animation->current.x = animation->from.x + (animation->to.x - animation->from.x) * progress;
+		animation->current.y = animation->from.y + (animation->to.y - animation->from.y) * progress;
+		animation->current.width = animation->from.width + ((double)animation->to.width - animation->from.width) * progress;
+		animation->current.height = animation->from.height + ((double)animation->to.height - animation->from.height) * progress;
+
+		XMoveResizeWindow(
+				state->display,
+				client->window,
+				animation->current.x,
+				animation->current.y,
+				MAX(1, animation->current.width),
+				MAX(1, animation->current.height));
+	}
+}
+
+Bool
+animation_timeout(state_t *state, struct timeval *timeout)
+{
+	double delay;
+
+	if (TAILQ_EMPTY(&state->animations)) {
+		return False;
+	}
+
+	delay = state->next_frame - animation_now();
+	if (delay < 0) {
+		delay = 0;
+	}
+
+	timeout->tv_sec = (time_t)delay;
+	timeout->tv_usec = (suseconds_t)((delay - timeout->tv_sec) * 1e6);
+
+	return True;
+}
@@ -0,0 +1,33 @@
+#ifndef __ANIMATION_H__
+#define __ANIMATION_H__
+
+#include <sys/time.h>
+
+#include <X11/Xlib.h>
+
+#include "queue.h"
+#include "xutils.h"
+
+struct client_t;
+struct state_t;
+
+typedef struct animation_t {
+	TAILQ_ENTRY(animation_t) entry;
+
+	struct client_t *client;
+
+	geometry_t from;
+	geometry_t to;
+	geometry_t current;
+	double start;
+} animation_t;
+
+TAILQ_HEAD(animation_q, animation_t);
+
+void animation_cancel(struct state_t *, struct client_t *);
+void animation_free(struct state_t *);
+Bool animation_start(struct state_t *, struct client_t *, geometry_t);
+void animation_tick(struct state_t *);
+Bool animation_timeout(struct state_t *, struct timeval *);
+
+#endif /* __ANIMATION_H__ */
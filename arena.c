@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "pool.h"
+
+#define ARENA_ALIGN (sizeof(void *) > sizeof(double) ? sizeof(void *) : sizeof(double))
+#define ARENA_ROUND(x) (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_CHUNK_SIZE 16384
+#define ARENA_HEADER_SIZE ARENA_ROUND(sizeof(arena_chunk_t))
+
+typedef struct arena_block_t {
+	char data[ARENA_CHUNK_SIZE];
+} arena_block_t;
+
+static pool_t arena_pool = POOL_INITIALIZER("arena chunk", arena_block_t, 4);
+
+void *
+arena_alloc(arena_t *arena, size_t size)
+{
+	arena_chunk_t *chunk = arena->chunks;
+	void *result;
+
+	size = ARENA_ROUND(size);
+
+	/*
+	 * Oversized requests get a chunk of their own, linked behind the current
+	 * one so that it keeps serving small allocations.
+	 */
+	if (ARENA_HEADER_SIZE + size > ARENA_CHUNK_SIZE) {
+		chunk = malloc(ARENA_HEADER_SIZE + size);
+		chunk->size = chunk->used = ARENA_HEADER_SIZE + size;
+
+		if (arena->chunks) {
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+		} else {
+			chunk->next = NULL;
+			arena->chunks = chunk;
+		}
+
+		return memset((char *)chunk + ARENA_HEADER_SIZE, 0, size);
+	}
+
+	if (!chunk || (chunk->used + size > chunk->size)) {
+		chunk = pool_alloc(&arena_pool);
+		chunk->size = ARENA_CHUNK_SIZE;
+		chunk->used = ARENA_HEADER_SIZE;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	result = (char *)chunk + chunk->used;
+	chunk->used += size;
+
+	return memset(result, 0, size);
+}
+
+void
+arena_free(arena_t *arena)
+{
+	arena_chunk_t *chunk;
+
+	while ((chunk = arena->chunks) != NULL) {
+		arena->chunks = chunk->next;
+
+		if (chunk->size > ARENA_CHUNK_SIZE) {
+			free(chunk);
+		} else {
+			pool_free(&arena_pool, chunk);
+		}
+	}
+}
+
+char *
+arena_strdup(arena_t *arena, const char *text)
+{
+	size_t length = strlen(text) + 1;
+
+	return memcpy(arena_alloc(arena, length), text, length);
+}
@@ -0,0 +1,25 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/*
+ * Bump-pointer arena. Allocations are never freed individually; everything
+ * handed out by an arena is released at once by arena_free().
+ */
+
+typedef struct arena_chunk_t {
+	struct arena_chunk_t *next;
+	size_t size;
+	size_t used;
+} arena_chunk_t;
+
+typedef struct arena_t {
+	arena_chunk_t *chunks;
+} arena_t;
+
+void *arena_alloc(arena_t *, size_t);
+void arena_free(arena_t *);
+char *arena_strdup(arena_t *, const char *);
+
+#endif /* __ARENA_H__ */
@@ -3,24 +3,55 @@
 #include <string.h>
 #include <time.h>
 
+#include <X11/Xatom.h>
 #include <X11/Xutil.h>
 
+#include "animation.h"
 #include "client.h"
 #include "config.h"
 #include "desktop.h"
+#include "drag.h"
 #include "ewmh.h"
 #include "group.h"
 #include "icccm.h"
+#include "intern.h"
+#include "menu.h"
+#include "pool.h"
 #include "screen.h"
 #include "state.h"
+#include "table.h"
 #include "utils.h"
 #include "xutils.h"
 
-void client_placement(state_t *, client_t *);
+void client_apply_rule(state_t *, client_t *, rule_t *, Bool);
+void client_placement(state_t *, client_t *, window_placement_t);
 void client_placement_cascade(state_t *, client_t *, geometry_t);
 void client_placement_pointer(state_t *, client_t *, geometry_t);
+void client_placement_smart(state_t *, client_t *, geometry_t);
 void client_update_class(state_t *, client_t *);
 
+/*
+ * Layout of the _MAGNETWM_STATE property: what magnetwm knows about a client
+ * that neither ICCCM nor EWMH properties carry across a restart.
+ */
+enum {
+	CLIENT_STATE_VERSION,
+	CLIENT_STATE_DESKTOP,
+	CLIENT_STATE_GROUP,
+	CLIENT_STATE_POSITION,
+	CLIENT_STATE_FLAGS,
+	CLIENT_STATE_SAVED_X,
+	CLIENT_STATE_SAVED_Y,
+	CLIENT_STATE_SAVED_WIDTH,
+	CLIENT_STATE_SAVED_HEIGHT,
+	CLIENT_STATE_NITEMS
+};
+
+#define CLIENT_STATE_CURRENT 1
+#define CLIENT_STATE_FLAGMASK (CLIENT_FREEZE)
+
+static pool_t client_pool = POOL_INITIALIZER("client", client_t, 64);
+
 void
 client_activate(state_t *state, client_t *client, Bool requeue)
 {
@@ -57,6 +88,54 @@ client_activate(state_t *state, client_t *client, Bool requeue)
 	ewmh_set_net_active_window(state, client);
 }
 
+/*
+ * Applies the actions of the rules matching a client. Windows adopted at
+ * startup keep their screen, desktop and size, which a restart restores.
+ */
+void
+client_apply_rule(state_t *state, client_t *client, rule_t *rule, Bool initial)
+{
+	screen_t *screen;
+
+	if (rule->ignore) {
+		client->flags |= CLIENT_IGNORE;
+		client->border_width = 0;
+	} else if (rule->border_width != -1) {
+		client->rule_border_width = rule->border_width;
+		client->border_width = rule->border_width;
+	}
+
+	if (rule->sticky != -1) {
+		client->flags &= ~CLIENT_STICKY;
+		client->flags |= rule->sticky ? CLIENT_STICKY : 0;
+		ewmh_set_net_wm_state(state, client);
+	}
+
+	if (initial) {
+		return;
+	}
+
+	if (rule->width != -1) {
+		client->geometry.width = rule->width;
+		client->geometry.height = rule->height;
+	}
+
+	if (rule->screen) {
+		screen = screen_find_by_name(state, rule->screen);
+		if (screen && (screen != client->group->desktop->screen)) {
+			screen_adopt(state, screen, client);
+		}
+	}
+
+	screen = client->group->desktop->screen;
+	if ((rule->desktop != -1) && (rule->desktop < screen->desktop_count)) {
+		if (client->group->desktop != screen->desktops[rule->desktop]) {
+			group_unassign(state, client);
+			group_assign(screen->desktops[rule->desktop], client);
+		}
+	}
+}
+
 void
 client_apply_size_hints(state_t *state, client_t *client)
 {
@@ -99,6 +178,13 @@ client_apply_size_hints(state_t *state, client_t *client)
 	}
 }
 
+/* The border width a normal window should have, as set by a rule or the config. */
+unsigned int
+client_border_width(state_t *state, client_t *client)
+{
+	return (client->rule_border_width != -1) ? client->rule_border_width : state->config->border_width;
+}
+
 void
 client_close(state_t *state, client_t *client)
 {
@@ -127,6 +213,8 @@ client_configure(state_t *state, client_t *client)
 	event.override_redirect = 0;
 
 	XSendEvent(state->display, client->window, False, StructureNotifyMask, (XEvent *)&event);
+
+	table_sync(client);
 }
 
 void
@@ -167,6 +255,8 @@ client_draw_border(state_t *state, client_t *client)
 	XSetWindowBorder(state->display, client->window, pixel);
 
 	ewmh_set_net_frame_extents(state, client);
+
+	table_sync(client);
 }
 
 client_t *
@@ -195,20 +285,11 @@ client_find(state_t *state, Window window)
 client_t *
 client_find_active(state_t *state)
 {
-	client_t *client;
-	group_t *group;
-	int i;
-	screen_t *screen;
+	size_t i;
 
-	TAILQ_FOREACH(screen, &state->screens, entry) {
-		for (i = 0; i < screen->desktop_count; i++) {
-			TAILQ_FOREACH(group, &screen->desktops[i]->groups, entry) {
-				TAILQ_FOREACH(client, &group->clients, entry) {
-					if (client->flags & CLIENT_ACTIVE) {
-						return client;
-					}
-				}
-			}
+	for (i = 0; i < table.count; i++) {
+		if (table.flags[i] & CLIENT_ACTIVE) {
+			return table.clients[i];
 		}
 	}
 
@@ -226,15 +307,12 @@ client_free(client_t *client)
 		free(client->name);
 	}
 
-	if (client->class_name) {
-		free(client->class_name);
-	}
+	intern_release(client->class_name);
+	intern_release(client->instance_name);
 
-	if (client->instance_name) {
-		free(client->instance_name);
-	}
+	table_remove(client);
 
-	free(client);
+	pool_free(&client_pool, client);
 }
 
 void
@@ -271,7 +349,7 @@ client_t *
 client_init(state_t *state, Window window, Bool initial)
 {
 	client_t *client;
-	ignored_t *ignored;
+	rule_t rule;
 	screen_t *screen;
 	XWindowAttributes attributes;
 
@@ -289,12 +367,13 @@ client_init(state_t *state, Window window, Bool initial)
 		}
 	}
 
-	client = calloc(1, sizeof(client_t));
+	client = pool_alloc(&client_pool);
 	client->window = window;
 	client->name = NULL;
 	client->class_name = NULL;
 	client->instance_name = NULL;
 	client->border_width = state->config->border_width;
+	client->rule_border_width = -1;
 	client->flags = 0;
 
 	client->mapped = (attributes.map_state == IsViewable);
@@ -307,10 +386,17 @@ client_init(state_t *state, Window window, Bool initial)
 
 	screen = screen_for_client(state, client);
 	if (!screen) {
-		free(client);
+		pool_free(&client_pool, client);
 		return NULL;
 	}
 
+	/* new windows open on the active screen */
+	if (!initial) {
+		screen = TAILQ_LAST(&state->screens, screen_q);
+	}
+
+	table_add(client);
+
 	client_update_class(state, client);
 	client_update_wm_name(state, client);
 	client_update_size_hints(state, client);
@@ -334,15 +420,13 @@ client_init(state_t *state, Window window, Bool initial)
 
 	ewmh_get_wm_window_type(state, client);
 
-	TAILQ_FOREACH(ignored, &state->config->ignored, entry) {
-		if (!strcmp(ignored->class_name, client->class_name)) {
-			client->flags |= CLIENT_IGNORE;
-			client->border_width = 0;
-		}
-	}
+	config_match(state->config, client, &rule);
+	client_apply_rule(state, client, &rule, initial);
+
+	table_sync(client);
 
 	if (!initial) {
-		client_placement(state, client);
+		client_placement(state, client, (rule.placement != -1) ? rule.placement : state->config->window_placement);
 	}
 
 	client_configure(state, client);
@@ -357,6 +441,76 @@ client_init(state_t *state, Window window, Bool initial)
 	return client;
 }
 
+/*
+ * Restores what client_save_state() stored before a restart: the desktop, the
+ * frozen flag and the geometry to restore. The order of the client's group
+ * on its desktop and of the client in its group are returned for the caller
+ * to apply once all clients are known. The property is removed once read.
+ */
+Bool
+client_load_state(state_t *state, client_t *client, long *group, long *position)
+{
+	desktop_t *desktop;
+	int count;
+	long *values;
+	screen_t *screen;
+
+	count = x_get_property(
+			state->display,
+			client->window,
+			state->magnetwm_state,
+			XA_CARDINAL,
+			CLIENT_STATE_NITEMS,
+			(unsigned char **)&values);
+	if (count <= 0) {
+		return False;
+	}
+
+	XDeleteProperty(state->display, client->window, state->magnetwm_state);
+
+	if ((count != CLIENT_STATE_NITEMS) || (values[CLIENT_STATE_VERSION] != CLIENT_STATE_CURRENT)) {
+		XFree(values);
+		return False;
+	}
+
+	client->flags &= ~CLIENT_STATE_FLAGMASK;
+	client->flags |= values[CLIENT_STATE_FLAGS] & CLIENT_STATE_FLAGMASK;
+
+	client->geometry_saved.x = values[CLIENT_STATE_SAVED_X];
+	client->geometry_saved.y = values[CLIENT_STATE_SAVED_Y];
+	client->geometry_saved.width = values[CLIENT_STATE_SAVED_WIDTH];
+	client->geometry_saved.height = values[CLIENT_STATE_SAVED_HEIGHT];
+
+	screen = client->group->desktop->screen;
+	if ((values[CLIENT_STATE_DESKTOP] >= 0) && (values[CLIENT_STATE_DESKTOP] < screen->desktop_count)) {
+		desktop = screen->desktops[values[CLIENT_STATE_DESKTOP]];
+		if (client->group->desktop != desktop) {
+			group_unassign(state, client);
+			group_assign(desktop, client);
+		}
+	}
+
+	/* the previous instance left it mapped only if its desktop was showing */
+	if (!(client->flags & CLIENT_STICKY)) {
+		if (client->group->desktop != screen->desktops[screen->desktop_index]) {
+			if (client->mapped) {
+				client_unmap(state, client);
+			}
+		} else if (!client->mapped && !(client->flags & CLIENT_HIDDEN)) {
+			client_map(state, client);
+			client->mapped = True;
+		}
+	}
+
+	*group = values[CLIENT_STATE_GROUP];
+	*position = values[CLIENT_STATE_POSITION];
+
+	XFree(values);
+	table_sync(client);
+
+	return True;
+}
+
 void
 client_lower(state_t *state, client_t *client)
 {
@@ -375,6 +529,8 @@ client_map(state_t *state, client_t *client)
 void
 client_move_resize(state_t *state, client_t *client, Bool reset)
 {
+	animation_cancel(state, client);
+
 	if (reset) {
 		client->flags &= ~CLIENT_MAXIMIZED;
 		ewmh_set_net_wm_state(state, client);
@@ -406,25 +562,26 @@ client_next(client_t *client)
 }
 
 #define FUZZY_DISTANCE 25
+#define PLACEMENT_CELL 16
 
 void
-client_placement(state_t *state, client_t *client)
+client_placement(state_t *state, client_t *client, window_placement_t placement)
 {
 	geometry_t screen_area;
 	screen_t *screen;
 
-	srand(time(0));
-
 	screen = client->group->desktop->screen;
 	screen_area = screen_available_area(screen);
 
 	if (client->hints.flags & (USPosition | PPosition)) {
 		// TODO: support hints
 	} else {
-		if (state->config->window_placement == WINDOW_PLACEMENT_CASCADE) {
+		if (placement == WINDOW_PLACEMENT_CASCADE) {
 			client_placement_cascade(state, client, screen_area);
-		} else if (state->config->window_placement == WINDOW_PLACEMENT_POINTER) {
+		} else if (placement == WINDOW_PLACEMENT_POINTER) {
 			client_placement_pointer(state, client, screen_area);
+		} else if (placement == WINDOW_PLACEMENT_SMART) {
+			client_placement_smart(state, client, screen_area);
 		}
 
 		if (client->geometry.x < screen_area.x) {
@@ -503,6 +660,111 @@ client_placement_pointer(state_t *state, client_t *client, geometry_t screen_are
 	client->geometry.y = y - client->geometry.height / 2 - client->border_width;
 }
 
+/*
+ * Puts the client where it overlaps the visible windows of its desktop the
+ * least, preferring the top-left of equally good spots. The screen area is
+ * divided into PLACEMENT_CELL sized cells; the windows are rasterized into
+ * it with a difference array, whose prefix sums give each cell's coverage
+ * and a summed-area table of it, which in turn gives the overlap at every
+ * position in constant time.
+ */
+void
+client_placement_smart(state_t *state, client_t *client, geometry_t screen_area)
+{
+	desktop_t *desktop;
+	geometry_t *geometry;
+	int best = -1, best_column = 0, best_row = 0, border, column, columns, height, overlap, row, rows, stride, width;
+	int column_from, column_to, row_from, row_to;
+	int *sums;
+	size_t i;
+
+	columns = (screen_area.width + PLACEMENT_CELL - 1) / PLACEMENT_CELL;
+	rows = (screen_area.height + PLACEMENT_CELL - 1) / PLACEMENT_CELL;
+	if ((columns <= 0) || (rows <= 0)) {
+		return;
+	}
+
+	stride = columns + 1;
+	sums = calloc((size_t)stride * (rows + 1), sizeof(int));
+	desktop = client->group->desktop;
+
+	/* sums[(row + 1) * stride + column + 1] starts out as the difference array */
+	for (i = 0; i < table.count; i++) {
+		if (!table.clients[i] || (table.clients[i] == client) || (table.screens[i] != desktop->screen)) {
+			continue;
+		}
+
+		if (table.flags[i] & (CLIENT_HIDDEN | CLIENT_IGNORE)) {
+			continue;
+		}
+
+		if ((table.groups[i]->desktop != desktop) && !(table.flags[i] & CLIENT_STICKY)) {
+			continue;
+		}
+
+		geometry = &table.geometry[i];
+		border = table.clients[i]->border_width;
+		column_from = MAX(0, (geometry->x - screen_area.x) / PLACEMENT_CELL);
+		row_from = MAX(0, (geometry->y - screen_area.y) / PLACEMENT_CELL);
+		column_to = MIN(columns, (geometry->x + geometry->width + 2 * border - screen_area.x + PLACEMENT_CELL - 1) / PLACEMENT_CELL);
+		row_to = MIN(rows, (geometry->y + geometry->height + 2 * border - screen_area.y + PLACEMENT_CELL - 1) / PLACEMENT_CELL);
+		if ((column_from >= column_to) || (row_from >= row_to)) {
+			continue;
+		}
+
+		sums[(row_from + 1) * stride + column_from + 1]++;
+		if (column_to < columns) {
+			sums[(row_from + 1) * stride + column_to + 1]--;
+		}
+
+		if (row_to < rows) {
+			sums[(row_to + 1) * stride + column_from + 1]--;
+			if (column_to < columns) {
+				sums[(row_to + 1) * stride + column_to + 1]++;
+			}
+		}
+	}
+
+	/* the first pass turns the differences into coverage, the second sums it */
+	for (row = 1; row <= rows; row++) {
+		for (column = 1; column <= columns; column++) {
+			sums[row * stride + column] += sums[(row - 1) * stride + column] + sums[row * stride + column - 1] - sums[(row - 1) * stride + column - 1];
+		}
+	}
+
+	for (row = 1; row <= rows; row++) {
+		for (column = 1; column <= columns; column++) {
+			sums[row * stride + column] += sums[(row - 1) * stride + column] + sums[row * stride + column - 1] - sums[(row - 1) * stride + column - 1];
+		}
+	}
+
+	width = MIN(columns, (client->geometry.width + 2 * (int)client->border_width + PLACEMENT_CELL - 1) / PLACEMENT_CELL);
+	height = MIN(rows, (client->geometry.height + 2 * (int)client->border_width + PLACEMENT_CELL - 1) / PLACEMENT_CELL);
+
+	for (row = 0; (row + height <= rows) && (best != 0); row++) {
+		for (column = 0; column + width <= columns; column++) {
+			overlap = sums[(row + height) * stride + column + width] -
+				sums[row * stride + column + width] -
+				sums[(row + height) * stride + column] +
+				sums[row * stride + column];
+
+			if ((best == -1) || (overlap < best)) {
+				best = overlap;
+				best_column = column;
+				best_row = row;
+				if (best == 0) {
+					break;
+				}
+			}
+		}
+	}
+
+	free(sums);
+
+	client->geometry.x = screen_area.x + best_column * PLACEMENT_CELL;
+	client->geometry.y = screen_area.y + best_row * PLACEMENT_CELL;
+}
+
 client_t *
 client_previous(client_t *client)
 {
@@ -538,10 +800,17 @@ client_remove(state_t *state, client_t *client)
 		ewmh_set_net_active_window(state, client);
 	}
 
+	drag_cancel(state, client);
+	animation_cancel(state, client);
+
 	shouldFocus = !(client->flags & CLIENT_HIDDEN) && !(client->flags & CLIENT_IGNORE);
 
+	if (state->menu) {
+		menu_remove(state->menu, client);
+	}
+
 	group = client->group;
-	group_unassign(client);
+	group_unassign(state, client);
 	client_free(client);
 
 	if (!shouldFocus) {
@@ -574,17 +843,50 @@ client_remove(state_t *state, client_t *client)
 void
 client_restore(state_t *state, client_t *client)
 {
+	geometry_t from = client->geometry;
+
 	if ((client->geometry_saved.width > 0) && (client->geometry_saved.height > 0)) {
 		client->flags &= ~CLIENT_HMAXIMIZED;
 		client->flags &= ~CLIENT_VMAXIMIZED;
 
 		client->geometry = client->geometry_saved;
 
-		client_move_resize(state, client, False);
+		client_transition(state, client, from, False);
 		ewmh_set_net_wm_state(state, client);
 	}
 }
 
+/*
+ * Stores the client's place in the desktop, group and client order together
+ * with the flags and saved geometry that would otherwise be lost when the
+ * window manager is restarted.
+ */
+void
+client_save_state(state_t *state, client_t *client, long desktop, long group, long position)
+{
+	long values[CLIENT_STATE_NITEMS];
+
+	values[CLIENT_STATE_VERSION] = CLIENT_STATE_CURRENT;
+	values[CLIENT_STATE_DESKTOP] = desktop;
+	values[CLIENT_STATE_GROUP] = group;
+	values[CLIENT_STATE_POSITION] = position;
+	values[CLIENT_STATE_FLAGS] = client->flags & CLIENT_STATE_FLAGMASK;
+	values[CLIENT_STATE_SAVED_X] = client->geometry_saved.x;
+	values[CLIENT_STATE_SAVED_Y] = client->geometry_saved.y;
+	values[CLIENT_STATE_SAVED_WIDTH] = client->geometry_saved.width;
+	values[CLIENT_STATE_SAVED_HEIGHT] = client->geometry_saved.height;
+
+	XChangeProperty(
+			state->display,
+			client->window,
+			state->magnetwm_state,
+			XA_CARDINAL,
+			32,
+			PropModeReplace,
+			(unsigned char *)values,
+			CLIENT_STATE_NITEMS);
+}
+
 void
 client_show(state_t *state, client_t *client)
 {
@@ -616,7 +918,7 @@ client_toggle_fullscreen(state_t *state, client_t *client)
 
 	if (client->flags & CLIENT_FULLSCREEN) {
 		if (!(client->flags & CLIENT_IGNORE)) {
-			client->border_width = state->config->border_width;
+			client->border_width = client_border_width(state, client);
 		}
 
 		client->geometry = client->geometry_saved;
@@ -663,7 +965,7 @@ client_toggle_hmaximize(state_t *state, client_t *client)
 void
 client_toggle_maximize(state_t *state, client_t *client)
 {
-	geometry_t screen_area;
+	geometry_t from = client->geometry, screen_area;
 	screen_t *screen;
 
 	if (client->flags & CLIENT_FREEZE) {
@@ -690,7 +992,7 @@ client_toggle_maximize(state_t *state, client_t *client)
 		client->flags |= CLIENT_MAXIMIZED;
 	}
 
-	client_move_resize(state, client, False);
+	client_transition(state, client, from, False);
 	ewmh_set_net_wm_state(state, client);
 }
 
@@ -743,6 +1045,20 @@ client_toggle_vmaximize(state_t *state, client_t *client)
 	ewmh_set_net_wm_state(state, client);
 }
 
+void
+client_transition(state_t *state, client_t *client, geometry_t from, Bool reset)
+{
+	if (!animation_start(state, client, from)) {
+		client_move_resize(state, client, reset);
+		return;
+	}
+
+	if (reset) {
+		client->flags &= ~CLIENT_MAXIMIZED;
+		ewmh_set_net_wm_state(state, client);
+	}
+}
+
 void
 client_unmap(state_t *state, client_t *client)
 {
@@ -764,15 +1080,15 @@ client_update_class(state_t *state, client_t *client)
 	XClassHint hint;
 
 	if (!XGetClassHint(state->display, client->window, &hint)) {
-		client->class_name = strdup("");
-		client->instance_name = strdup("");
+		client->class_name = intern("");
+		client->instance_name = intern("");
 		return;
 	}
 
-	client->class_name = strdup(hint.res_class);
+	client->class_name = intern(hint.res_class);
 	XFree(hint.res_class);
 
-	client->instance_name = strdup(hint.res_name);
+	client->instance_name = intern(hint.res_name);
 	XFree(hint.res_name);
 }
 
@@ -868,7 +1184,7 @@ client_update_wm_name(state_t *state, client_t *client)
 
 	if (client->group) {
 		if (!client->group->name || !strlen(client->group->name)) {
-			client->group->name = strdup(client->name);
+			group_rename(client->group, client->name);
 		}
 	}
 }
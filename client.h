@@ -79,16 +79,20 @@ typedef struct client_t {
 	unsigned long flags;
 	long initial_state;
 	unsigned int border_width;
+	int rule_border_width;
 	Bool mapped;
 	client_type_t type;
 
 	geometry_t geometry;
 	geometry_t geometry_saved;
 	strut_t strut;
+
+	size_t slot;
 } client_t;
 
 void client_activate(struct state_t *, client_t *, Bool);
 void client_apply_size_hints(struct state_t *, client_t *);
+unsigned int client_border_width(struct state_t *, client_t *);
 void client_close(struct state_t *, client_t *);
 void client_configure(struct state_t *, client_t *);
 void client_deactivate(struct state_t *, client_t *);
@@ -98,6 +102,7 @@ client_t *client_find_active(struct state_t *);
 void client_free(client_t *);
 void client_hide(struct state_t *, client_t *);
 client_t *client_init(struct state_t *, Window, Bool);
+Bool client_load_state(struct state_t *, client_t *, long *, long *);
 void client_lower(struct state_t *, client_t *);
 void client_map(struct state_t *, client_t *);
 void client_move_resize(struct state_t *, client_t *, Bool);
@@ -106,6 +111,7 @@ client_t *client_previous(client_t *);
 void client_raise(struct state_t *, client_t *);
 void client_remove(struct state_t *, client_t *);
 void client_restore(struct state_t *, client_t *);
+void client_save_state(struct state_t *, client_t *, long, long, long);
 void client_show(struct state_t *, client_t *);
 void client_toggle_freeze(struct state_t *, client_t *);
 void client_toggle_fullscreen(struct state_t *, client_t *);
@@ -117,6 +123,7 @@ void client_toggle_skip_taskbar(struct state_t *, client_t *);
 void client_toggle_sticky(struct state_t *, client_t *);
 void client_toggle_urgent(struct state_t *, client_t *);
 void client_toggle_vmaximize(struct state_t *, client_t *);
+void client_transition(struct state_t *, client_t *, geometry_t, Bool);
 void client_unmap(struct state_t *, client_t *);
 void client_update_size_hints(struct state_t *, client_t *);
 void client_update_wm_hints(struct state_t *, client_t *);
@@ -5,11 +5,13 @@
 
 #include "queue.h"
 
+struct client_t;
 struct state_t;
 
 TAILQ_HEAD(command_q, command_t);
 TAILQ_HEAD(binding_q, binding_t);
-TAILQ_HEAD(ignored_q, ignored_t);
+
+#define CONFIG_RULE_BUCKETS 64
 
 typedef enum {
 	BINDING_CONTEXT_CLIENT,
@@ -57,9 +59,20 @@ typedef enum {
 	FONT_NITEMS
 } font_t;
 
+typedef enum {
+	MENU_SORT_BYTES,
+	MENU_SORT_LOCALE
+} menu_sort_t;
+
+typedef enum {
+	MENU_MATCH_SUBSTRING,
+	MENU_MATCH_FUZZY
+} menu_match_t;
+
 typedef enum {
 	WINDOW_PLACEMENT_CASCADE,
-	WINDOW_PLACEMENT_POINTER
+	WINDOW_PLACEMENT_POINTER,
+	WINDOW_PLACEMENT_SMART
 } window_placement_t;
 
 typedef struct binding_t {
@@ -73,19 +86,48 @@ typedef struct binding_t {
 	void (*function)(struct state_t *, void *, long);
 } binding_t;
 
-typedef struct ignored_t {
-	TAILQ_ENTRY(ignored_t) entry;
-
+/*
+ * A window rule: the actions apply to windows matching every criterion that
+ * is set. Unset numbers are -1 and unset strings NULL. Rules with a literal
+ * class or instance are hashed by it; the others are kept on a list that is
+ * scanned for every window.
+ */
+typedef struct rule_t {
+	struct rule_t *next;
+	unsigned int index;
+
+	/* interned */
 	char *class_name;
-} ignored_t;
+	char *instance_name;
+	Bool class_glob;
+	Bool instance_glob;
+	char *title;
+	long type;
+
+	long desktop;
+	char *screen;
+	long placement;
+	long border_width;
+	long sticky;
+	Bool ignore;
+	long width;
+	long height;
+} rule_t;
 
 typedef struct config_t {
+	char *path;
+	int errors;
+
 	char *wm_name;
 
 	struct command_q commands;
 	struct binding_q keybindings;
 	struct binding_q mousebindings;
-	struct ignored_q ignored;
+
+	rule_t *class_rules[CONFIG_RULE_BUCKETS];
+	rule_t *instance_rules[CONFIG_RULE_BUCKETS];
+	rule_t *pattern_rules;
+	unsigned int rule_count;
 
 	char *colors[COLOR_NITEMS];
 	char *fonts[FONT_NITEMS];
@@ -93,6 +135,8 @@ typedef struct config_t {
 
 	double transition_duration;
 	int border_width;
+	menu_match_t menu_match;
+	menu_sort_t menu_sort;
 	window_placement_t window_placement;
 } config_t;
 
@@ -103,5 +147,6 @@ void config_bind_command(config_t *, char *, char *);
 Bool config_bind_key(config_t *, char *, char *);
 Bool config_bind_mouse(config_t *, char *, char *);
 void config_ignore(config_t *, char *);
+void config_match(config_t *, struct client_t *, rule_t *);
 
 #endif /* __CONFIG_H__ */
@@ -3,6 +3,7 @@
 #include <ctype.h>
 #include <err.h>
 #include <errno.h>
+#include <fnmatch.h>
 #include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -10,8 +11,10 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include "client.h"
 #include "config.h"
 #include "functions.h"
+#include "intern.h"
 #include "state.h"
 #include "utils.h"
 #include "queue.h"
@@ -100,12 +103,31 @@ static const struct {
 	{ FUNC_CC(window-tile-up-third-right, window_tile, DIRECTION_UP_THIRD | DIRECTION_RIGHT) },
 	{ FUNC_CC(window-tile-up-third-right-third, window_tile, DIRECTION_UP_THIRD | DIRECTION_RIGHT_THIRD) },
 	{ FUNC_GC(quit, wm_state, 3) },
+	{ FUNC_GC(reload, wm_state, 4) },
 	{ FUNC_GC(restart, wm_state, 2) },
 #undef FUNC_CC
 #undef FUNC_SC
 #undef FUNC_GC
 };
 
+/* indexed by client_type_t */
+static const char *window_types[] = {
+	"desktop",
+	"dock",
+	"toolbar",
+	"menu",
+	"utility",
+	"splash",
+	"dialog",
+	"dropdown-menu",
+	"popup-menu",
+	"tooltip",
+	"notification",
+	"combo",
+	"dnd",
+	"normal",
+};
+
 TAILQ_HEAD(files, file_t) files = TAILQ_HEAD_INITIALIZER(files);
 
 typedef struct {
@@ -117,6 +139,12 @@ typedef struct {
 } YYSTYPE;
 
 char *config_bind_mask(char *, unsigned int *);
+Bool config_match_name(char *, Bool, char *);
+Bool config_rule_add(config_t *, rule_t *);
+void config_rule_free(rule_t *);
+rule_t *config_rule_init(void);
+Bool config_rule_matches(rule_t *, client_t *);
+void config_rule_reset(rule_t *);
 int findeol(void);
 int kw_cmp(const void *, const void *);
 int lgetc(int);
@@ -135,6 +163,7 @@ int parseindex, pushback_index = 0;
 file_t *file;
 file_t *topfile;
 static config_t *config;
+static rule_t *rule;
 
 %}
 
@@ -146,26 +175,42 @@ static config_t *config;
 %token BORDERMARK
 %token BORDERURGENT
 %token BORDERWIDTH
+%token BYTES
 %token CASCADE
+%token CLASS
 %token COLOR
 %token COMMAND
+%token DESKTOP
 %token ERROR
 %token FONT
+%token FUZZY
 %token IGNORE
+%token INSTANCE
 %token LABEL
+%token LOCALE
 %token MENUBACKGROUND
 %token MENUFOREGROUND
 %token MENUINPUT
 %token MENUITEM
 %token MENUITEMDETAIL
+%token MENUMATCH
 %token MENUPROMPT
 %token MENUSELECTIONBACKGROUND
 %token MENUSELECTIONFOREGROUND
 %token MENUSEPARATOR
+%token MENUSORT
 %token NO
 %token POINTER
+%token RULE
 %token RUN
+%token SCREEN
+%token SIZE
+%token SMART
+%token STICKY
+%token SUBSTRING
+%token TITLE
 %token TRANSITIONDURATION
+%token TYPE
 %token WINDOWACTIVE
 %token WINDOWHIDDEN
 %token WINDOWINACTIVE
@@ -361,6 +406,28 @@ main	: BINDKEY STRING string {
 			config_ignore(config, $2);
 			free($2);
 		}
+		| MENUMATCH FUZZY {
+			config->menu_match = MENU_MATCH_FUZZY;
+		}
+		| MENUMATCH SUBSTRING {
+			config->menu_match = MENU_MATCH_SUBSTRING;
+		}
+		| MENUSORT BYTES {
+			config->menu_sort = MENU_SORT_BYTES;
+		}
+		| MENUSORT LOCALE {
+			config->menu_sort = MENU_SORT_LOCALE;
+		}
+		| RULE {
+			config_rule_free(rule);
+			rule = config_rule_init();
+		} rulespecs {
+			if (!config_rule_add(config, rule)) {
+				yyerror("rule without class, instance, title or type");
+				config_rule_free(rule);
+			}
+			rule = NULL;
+		}
 		| TRANSITIONDURATION NUMBER {
 			config->transition_duration = (double)$2 / 1000.0;
 		}
@@ -370,6 +437,9 @@ main	: BINDKEY STRING string {
 		| WINDOWPLACEMENT POINTER {
 			config->window_placement = WINDOW_PLACEMENT_POINTER;
 		}
+		| WINDOWPLACEMENT SMART {
+			config->window_placement = WINDOW_PLACEMENT_SMART;
+		}
 		| WMNAME STRING {
 			free(config->wm_name);
 			config->wm_name = strdup($2);
@@ -377,6 +447,78 @@ main	: BINDKEY STRING string {
 		}
 		;
 
+rulespecs	: rulespec
+		| rulespecs rulespec
+		;
+
+rulespec	: CLASS STRING {
+			intern_release(rule->class_name);
+			rule->class_name = intern($2);
+			rule->class_glob = (strpbrk($2, "*?[") != NULL);
+			free($2);
+		}
+		| INSTANCE STRING {
+			intern_release(rule->instance_name);
+			rule->instance_name = intern($2);
+			rule->instance_glob = (strpbrk($2, "*?[") != NULL);
+			free($2);
+		}
+		| TITLE STRING {
+			free(rule->title);
+			rule->title = $2;
+		}
+		| TYPE STRING {
+			for (rule->type = 0; rule->type <= CLIENT_TYPE_NORMAL; rule->type++) {
+				if (!strcmp(window_types[rule->type], $2)) {
+					break;
+				}
+			}
+			if (rule->type > CLIENT_TYPE_NORMAL) {
+				yyerror("invalid window type: %s", $2);
+				free($2);
+				YYERROR;
+			}
+			free($2);
+		}
+		| DESKTOP NUMBER {
+			if ($2 < 1) {
+				yyerror("invalid desktop: %lld", (long long)$2);
+				YYERROR;
+			}
+			rule->desktop = $2 - 1;
+		}
+		| SCREEN STRING {
+			free(rule->screen);
+			rule->screen = $2;
+		}
+		| WINDOWPLACEMENT CASCADE {
+			rule->placement = WINDOW_PLACEMENT_CASCADE;
+		}
+		| WINDOWPLACEMENT POINTER {
+			rule->placement = WINDOW_PLACEMENT_POINTER;
+		}
+		| WINDOWPLACEMENT SMART {
+			rule->placement = WINDOW_PLACEMENT_SMART;
+		}
+		| BORDERWIDTH NUMBER {
+			rule->border_width = $2;
+		}
+		| STICKY yesno {
+			rule->sticky = $2;
+		}
+		| IGNORE {
+			rule->ignore = True;
+		}
+		| SIZE NUMBER NUMBER {
+			if (($2 < 1) || ($3 < 1)) {
+				yyerror("invalid size: %lld %lld", (long long)$2, (long long)$3);
+				YYERROR;
+			}
+			rule->width = $2;
+			rule->height = $3;
+		}
+		;
+
 %%
 
 int
@@ -465,28 +607,44 @@ lookup(char *s)
 		{ "border-mark", BORDERMARK },
 		{ "border-urgent", BORDERURGENT },
 		{ "border-width", BORDERWIDTH },
+		{ "bytes", BYTES },
 		{ "cascade", CASCADE },
+		{ "class", CLASS },
 		{ "color", COLOR },
 		{ "command", COMMAND },
+		{ "desktop", DESKTOP },
 		{ "font", FONT },
+		{ "fuzzy", FUZZY },
 		{ "ignore", IGNORE },
+		{ "instance", INSTANCE },
 		{ "label", LABEL },
+		{ "locale", LOCALE },
 		{ "menu-background", MENUBACKGROUND },
 		{ "menu-foreground", MENUFOREGROUND },
 		{ "menu-input", MENUINPUT },
 		{ "menu-item", MENUITEM },
 		{ "menu-item-detail", MENUITEMDETAIL },
+		{ "menu-match", MENUMATCH },
 		{ "menu-prompt", MENUPROMPT },
 		{ "menu-selection-background", MENUSELECTIONBACKGROUND },
 		{ "menu-selection-foreground", MENUSELECTIONFOREGROUND },
 		{ "menu-separator", MENUSEPARATOR },
+		{ "menu-sort", MENUSORT },
 		{ "no", NO },
 		{ "pointer", POINTER },
+		{ "rule", RULE },
 		{ "run", RUN },
+		{ "screen", SCREEN },
+		{ "size", SIZE },
+		{ "smart", SMART },
+		{ "sticky", STICKY },
+		{ "substring", SUBSTRING },
+		{ "title", TITLE },
 		{ "transition-duration", TRANSITIONDURATION },
+		{ "type", TYPE },
 		{ "window-active", WINDOWACTIVE },
-		{ "window-inactive", WINDOWINACTIVE },
 		{ "window-hidden", WINDOWHIDDEN },
+		{ "window-inactive", WINDOWINACTIVE },
 		{ "window-placement", WINDOWPLACEMENT },
 		{ "windows", WINDOWS },
 		{ "wm-name", WMNAME },
@@ -834,25 +992,39 @@ config_free(config_t *config)
 		free(binding);
 	}
 
-	for (i = 0; i < FONT_NITEMS; i++)
+	for (i = 0; i < CONFIG_RULE_BUCKETS; i++) {
+		config_rule_free(config->class_rules[i]);
+		config_rule_free(config->instance_rules[i]);
+	}
+
+	config_rule_free(config->pattern_rules);
+
+	for (i = 0; i < COLOR_NITEMS; i++) {
+		free(config->colors[i]);
+	}
+
+	for (i = 0; i < FONT_NITEMS; i++) {
 		free(config->fonts[i]);
+	}
+
+	for (i = 0; i < LABEL_NITEMS; i++) {
+		free(config->labels[i]);
+	}
 
+	free(config->wm_name);
+	free(config->path);
 	free(config);
 }
 
 void
 config_ignore(config_t *config, char *class_name)
 {
-	ignored_t *ignored;
-	TAILQ_FOREACH(ignored, &config->ignored, entry) {
-		if (!strcmp(ignored->class_name, class_name)) {
-			return;
-		}
-	}
+	rule_t *ignore;
 
-	ignored = calloc(1, sizeof(ignored_t));
-	ignored->class_name = strdup(class_name);
-	TAILQ_INSERT_TAIL(&config->ignored, ignored, entry);
+	ignore = config_rule_init();
+	ignore->class_name = intern(class_name);
+	ignore->ignore = True;
+	config_rule_add(config, ignore);
 }
 
 config_t *
@@ -864,6 +1036,8 @@ config_init()
 
 	config = malloc(sizeof(config_t));
 
+	config->path = NULL;
+	config->errors = 0;
 	config->wm_name = strdup("MagnetWM");
 
 	config->colors[COLOR_BORDER_ACTIVE] = strdup("green");
@@ -883,6 +1057,8 @@ config_init()
 
 	config->transition_duration = 0.0;
 	config->border_width = 1;
+	config->menu_match = MENU_MATCH_SUBSTRING;
+	config->menu_sort = MENU_SORT_BYTES;
 	config->window_placement = WINDOW_PLACEMENT_CASCADE;
 
 	config->labels[LABEL_APPLICATIONS] = strdup("Application");
@@ -896,7 +1072,10 @@ config_init()
 	TAILQ_INIT(&config->commands);
 	TAILQ_INIT(&config->keybindings);
 	TAILQ_INIT(&config->mousebindings);
-	TAILQ_INIT(&config->ignored);
+	memset(config->class_rules, 0, sizeof(config->class_rules));
+	memset(config->instance_rules, 0, sizeof(config->instance_rules));
+	config->pattern_rules = NULL;
+	config->rule_count = 0;
 
 	config_bind_command(config, "terminal", "xterm");
 
@@ -913,16 +1092,196 @@ config_init()
 		}
 	}
 
+	config->path = strdup(path);
+
 	file = pushfile(path, stream);
 	topfile = file;
+	pushback_index = 0;
 
 	yyparse();
 	errors = file->errors;
 	popfile();
 
+	config_rule_free(rule);
+	rule = NULL;
+
 	if (errors > 0) {
 		fprintf(stderr, "Encountered %d errors\n", errors);
 	}
 
+	config->errors = errors;
+
 	return config;
 }
+
+/*
+ * Merges the actions of every rule matching the client into result, later
+ * rules overriding earlier ones. Only the rules hashed under the client's
+ * class and instance and the pattern rules are looked at; the three chains
+ * are each in definition order and are merged by rule index.
+ */
+void
+config_match(config_t *config, client_t *client, rule_t *result)
+{
+	int i, next;
+	rule_t *chains[3], *match;
+
+	config_rule_reset(result);
+
+	chains[0] = config->class_rules[INTERN_HASH_POINTER(client->class_name, CONFIG_RULE_BUCKETS)];
+	chains[1] = config->instance_rules[INTERN_HASH_POINTER(client->instance_name, CONFIG_RULE_BUCKETS)];
+	chains[2] = config->pattern_rules;
+
+	for (;;) {
+		next = -1;
+		for (i = 0; i < 3; i++) {
+			if (chains[i] && ((next == -1) || (chains[i]->index < chains[next]->index))) {
+				next = i;
+			}
+		}
+
+		if (next == -1) {
+			break;
+		}
+
+		match = chains[next];
+		chains[next] = match->next;
+
+		if (!config_rule_matches(match, client)) {
+			continue;
+		}
+
+		if (match->desktop != -1) {
+			result->desktop = match->desktop;
+		}
+
+		if (match->screen) {
+			result->screen = match->screen;
+		}
+
+		if (match->placement != -1) {
+			result->placement = match->placement;
+		}
+
+		if (match->border_width != -1) {
+			result->border_width = match->border_width;
+		}
+
+		if (match->sticky != -1) {
+			result->sticky = match->sticky;
+		}
+
+		if (match->ignore) {
+			result->ignore = True;
+		}
+
+		if (match->width != -1) {
+			result->width = match->width;
+			result->height = match->height;
+		}
+	}
+}
+
+Bool
+config_match_name(char *pattern, Bool glob, char *name)
+{
+	if (!pattern) {
+		return True;
+	}
+
+	if (glob) {
+		return fnmatch(pattern, name ? name : "", 0) == 0;
+	}
+
+	/* both are interned */
+	return pattern == name;
+}
+
+/*
+ * Files the rule under its literal class or, failing that, its literal
+ * instance; rules matching on patterns, titles or types alone go on the
+ * pattern list. Rules match nothing without any of those.
+ */
+Bool
+config_rule_add(config_t *config, rule_t *rule)
+{
+	rule_t **chain;
+
+	if (rule->class_name && !rule->class_glob) {
+		chain = &config->class_rules[INTERN_HASH_POINTER(rule->class_name, CONFIG_RULE_BUCKETS)];
+	} else if (rule->instance_name && !rule->instance_glob) {
+		chain = &config->instance_rules[INTERN_HASH_POINTER(rule->instance_name, CONFIG_RULE_BUCKETS)];
+	} else if (rule->class_name || rule->instance_name || rule->title || (rule->type != -1)) {
+		chain = &config->pattern_rules;
+	} else {
+		return False;
+	}
+
+	while (*chain) {
+		chain = &(*chain)->next;
+	}
+
+	rule->index = config->rule_count++;
+	*chain = rule;
+
+	return True;
+}
+
+/* Frees the rule and those chained after it. */
+void
+config_rule_free(rule_t *rule)
+{
+	rule_t *next;
+
+	for (; rule; rule = next) {
+		next = rule->next;
+		intern_release(rule->class_name);
+		intern_release(rule->instance_name);
+		free(rule->title);
+		free(rule->screen);
+		free(rule);
+	}
+}
+
+rule_t *
+config_rule_init(void)
+{
+	rule_t *rule;
+
+	rule = malloc(sizeof(rule_t));
+	config_rule_reset(rule);
+
+	return rule;
+}
+
+Bool
+config_rule_matches(rule_t *rule, client_t *client)
+{
+	if (!config_match_name(rule->class_name, rule->class_glob, client->class_name)) {
+		return False;
+	}
+
+	if (!config_match_name(rule->instance_name, rule->instance_glob, client->instance_name)) {
+		return False;
+	}
+
+	if (rule->title && (fnmatch(rule->title, client->name ? client->name : "", 0) != 0)) {
+		return False;
+	}
+
+	return (rule->type == -1) || (rule->type == (long)client->type);
+}
+
+/* Leaves the rule without criteria or actions. */
+void
+config_rule_reset(rule_t *rule)
+{
+	memset(rule, 0, sizeof(rule_t));
+	rule->type = -1;
+	rule->desktop = -1;
+	rule->placement = -1;
+	rule->border_width = -1;
+	rule->sticky = -1;
+	rule->width = -1;
+	rule->height = -1;
+}
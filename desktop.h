@@ -9,12 +9,15 @@ struct state_t;
 
 TAILQ_HEAD(group_q, group_t);
 
+#define DESKTOP_GROUP_BUCKETS 32
+
 typedef struct desktop_t {
 	TAILQ_ENTRY(desktop_t) entry;
 
 	char *name;
 
 	struct group_q groups;
+	struct group_t *group_table[DESKTOP_GROUP_BUCKETS];
 	struct screen_t *screen;
 } desktop_t;
 
@@ -0,0 +1,149 @@
+#include <X11/Xlib.h>
+
+#include "client.h"
+#include "desktop.h"
+#include "drag.h"
+#include "group.h"
+#include "screen.h"
+#include "state.h"
+#include "xutils.h"
+
+#define DRAGMASK (ButtonPressMask | ButtonReleaseMask | PointerMotionMask)
+
+Bool
+drag_begin(state_t *state, client_t *client, drag_mode_t mode)
+{
+	Cursor cursor;
+	int result, x, y;
+
+	if ((state->drag.mode != DRAG_NONE) || state->menu) {
+		return False;
+	}
+
+	if (!x_get_pointer(state->display, client->window, &x, &y)) {
+		return False;
+	}
+
+	if (mode == DRAG_MOVE) {
+		cursor = state->cursors[CURSOR_MOVE];
+	} else if (x < client->geometry.x + client->geometry.width / 2) {
+		if (y < client->geometry.y + client->geometry.height / 2) {
+			cursor = state->cursors[CURSOR_RESIZE_TOP_LEFT];
+		} else {
+			cursor = state->cursors[CURSOR_RESIZE_BOTTOM_LEFT];
+		}
+	} else {
+		if (y < client->geometry.y + client->geometry.height / 2) {
+			cursor = state->cursors[CURSOR_RESIZE_TOP_RIGHT];
+		} else {
+			cursor = state->cursors[CURSOR_RESIZE_BOTTOM_RIGHT];
+		}
+	}
+
+	result = XGrabPointer(
+			state->display,
+			client->window,
+			False,
+			DRAGMASK,
+			GrabModeAsync,
+			GrabModeAsync,
+			None,
+			cursor,
+			CurrentTime);
+	if (result != GrabSuccess) {
+		return False;
+	}
+
+	client->geometry_saved = client->geometry;
+
+	state->drag.mode = mode;
+	state->drag.client = client;
+	state->drag.x = x;
+	state->drag.y = y;
+	state->drag.width = client->geometry.width;
+	state->drag.height = client->geometry.height;
+	state->drag.screen_area = screen_available_area(client->group->desktop->screen);
+	state->drag.time = 0;
+
+	return True;
+}
+
+void
+drag_cancel(state_t *state, client_t *client)
+{
+	if ((state->drag.mode == DRAG_NONE) || (state->drag.client != client)) {
+		return;
+	}
+
+	XUngrabPointer(state->display, CurrentTime);
+
+	state->drag.mode = DRAG_NONE;
+	state->drag.client = NULL;
+}
+
+void
+drag_end(state_t *state)
+{
+	client_t *client = state->drag.client;
+	drag_mode_t mode = state->drag.mode;
+	screen_t *screen;
+
+	if (mode == DRAG_NONE) {
+		return;
+	}
+
+	state->drag.mode = DRAG_NONE;
+	state->drag.client = NULL;
+
+	XUngrabPointer(state->display, CurrentTime);
+
+	if (mode == DRAG_MOVE) {
+		screen = screen_for_client(state, client);
+		if (screen && (screen != client->group->desktop->screen)) {
+			screen_adopt(state, screen, client);
+		}
+	}
+
+	XFlush(state->display);
+}
+
+void
+drag_motion(state_t *state, XMotionEvent *event)
+{
+	client_t *client = state->drag.client;
+	drag_t *drag = &state->drag;
+	XEvent next;
+
+	if (drag->mode == DRAG_NONE) {
+		return;
+	}
+
+	/* Only the most recent position matters, drop the stale ones. */
+	while (XCheckTypedWindowEvent(state->display, event->window, MotionNotify, &next)) {
+		*event = next.xmotion;
+	}
+
+	if (event->time - drag->time <= 1000 / 60) {
+		return;
+	}
+
+	drag->time = event->time;
+
+	if (drag->mode == DRAG_MOVE) {
+		client->geometry.x += event->x_root - drag->x;
+		client->geometry.y += event->y_root - drag->y;
+		if (client->geometry.y < drag->screen_area.y) {
+			client->geometry.y = drag->screen_area.y;
+		}
+
+		drag->x = event->x_root;
+		drag->y = event->y_root;
+	} else {
+		client->geometry.width = drag->width + event->x_root - drag->x;
+		client->geometry.height = drag->height + event->y_root - drag->y;
+
+		client_apply_size_hints(state, client);
+	}
+
+	client_move_resize(state, client, True);
+}
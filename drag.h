@@ -0,0 +1,34 @@
+#ifndef __DRAG_H__
+#define __DRAG_H__
+
+#include <X11/Xlib.h>
+
+#include "xutils.h"
+
+struct client_t;
+struct state_t;
+
+typedef enum drag_mode_t {
+	DRAG_NONE,
+	DRAG_MOVE,
+	DRAG_RESIZE
+} drag_mode_t;
+
+typedef struct drag_t {
+	drag_mode_t mode;
+	struct client_t *client;
+
+	int x;
+	int y;
+	unsigned int width;
+	unsigned int height;
+	geometry_t screen_area;
+	Time time;
+} drag_t;
+
+Bool drag_begin(struct state_t *, struct client_t *, drag_mode_t);
+void drag_cancel(struct state_t *, struct client_t *);
+void drag_end(struct state_t *);
+void drag_motion(struct state_t *, XMotionEvent *);
+
+#endif /* __DRAG_H__ */
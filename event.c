@@ -6,19 +6,23 @@
 #include "client.h"
 #include "config.h"
 #include "desktop.h"
+#include "drag.h"
 #include "ewmh.h"
 #include "group.h"
 #include "icccm.h"
+#include "menu.h"
 #include "screen.h"
 #include "state.h"
 
 void event_handle_button_press(state_t *, XButtonPressedEvent *);
+void event_handle_button_release(state_t *, XButtonReleasedEvent *);
 void event_handle_client_message(state_t *, XClientMessageEvent *);
 void event_handle_configure_request(state_t *, XConfigureRequestEvent *);
 void event_handle_destroy_notify(state_t *, XDestroyWindowEvent *);
 void event_handle_key_press(state_t *, XKeyEvent *);
 void event_handle_leave_notify(state_t *, XCrossingEvent *);
 void event_handle_map_request(state_t *, XMapRequestEvent *);
+void event_handle_motion_notify(state_t *, XMotionEvent *);
 void event_handle_property_notify(state_t *, XPropertyEvent *);
 void event_handle_reparent_notify(state_t *, XReparentEvent *);
 
@@ -29,6 +33,10 @@ event_handle_button_press(state_t *state, XButtonPressedEvent *event)
 	binding_t *binding;
 	screen_t *screen;
 
+	if (state->drag.mode != DRAG_NONE) {
+		return;
+	}
+
 	screen = screen_for_point(state, event->x_root, event->y_root);
 	screen_activate(state, screen);
 
@@ -61,10 +69,27 @@ event_handle_button_press(state_t *state, XButtonPressedEvent *event)
 		}
 	}
 
-	XAllowEvents(state->display, ReplayPointer, event->time);
+	/*
+	 * Replaying the press would release the pointer grab a binding has just
+	 * taken for an interactive move or resize.
+	 */
+	if (state->drag.mode != DRAG_NONE) {
+		XAllowEvents(state->display, AsyncPointer, event->time);
+	} else {
+		XAllowEvents(state->display, ReplayPointer, event->time);
+	}
+
 	XSync(state->display, 0);
 }
 
+void
+event_handle_button_release(state_t *state, XButtonReleasedEvent *event)
+{
+	if (state->drag.mode != DRAG_NONE) {
+		drag_end(state);
+	}
+}
+
 void
 event_handle_client_message(state_t *state, XClientMessageEvent *event)
 {
@@ -214,16 +239,18 @@ event_handle_map_request(state_t *state, XMapRequestEvent *event)
 	client_t *client;
 	screen_t *screen;
 
-	screen = TAILQ_LAST(&state->screens, screen_q);
-
 	client = client_find(state, event->window);
 	if (!client) {
 		client = client_init(state, event->window, False);
 		if (!client) {
 			return;
 		}
+	}
 
-		screen_adopt(state, screen, client);
+	/* a rule may have sent it to another desktop; it is mapped on switching */
+	screen = client->group->desktop->screen;
+	if ((client->group->desktop != screen->desktops[screen->desktop_index]) && !(client->flags & CLIENT_STICKY)) {
+		return;
 	}
 
 	client->mapped = True;
@@ -237,6 +264,14 @@ event_handle_map_request(state_t *state, XMapRequestEvent *event)
 	TAILQ_INSERT_TAIL(&client->group->desktop->groups, client->group, entry);
 }
 
+void
+event_handle_motion_notify(state_t *state, XMotionEvent *event)
+{
+	if (state->drag.mode != DRAG_NONE) {
+		drag_motion(state, event);
+	}
+}
+
 void
 event_handle_property_notify(state_t *state, XPropertyEvent *event)
 {
@@ -260,6 +295,10 @@ event_process(state_t *state)
 	while (XPending(state->display)) {
 		XNextEvent(state->display, &event);
 
+		if (state->menu && menu_handle_event(state->menu, &event)) {
+			continue;
+		}
+
 		switch (event.type) {
 			case KeyPress:
 				event_handle_key_press(state, &event.xkey);
@@ -273,12 +312,12 @@ event_process(state_t *state)
 				event_handle_button_press(state, &event.xbutton);
 				break;
 			case ButtonRelease:
-				printf("button release\n");
+				event_handle_button_release(state, &event.xbutton);
 				break;
-				/*
 			case MotionNotify:
-				printf("motion notify\n");
+				event_handle_motion_notify(state, &event.xmotion);
 				break;
+				/*
 			case EnterNotify:
 				event_handle_enter_notify(state, &event.xcrossing);
 				break;
@@ -9,6 +9,8 @@
 #include "icccm.h"
 #include "screen.h"
 #include "state.h"
+#include "table.h"
+#include "utils.h"
 #include "xutils.h"
 
 void
@@ -94,6 +96,8 @@ ewmh_get_net_wm_strut(state_t *state, client_t *client)
 	client->strut.bottom_start_x = 0;
 	client->strut.bottom_end_x = client->strut.bottom == 0 ? 0 : screen->geometry.width - 1;
 
+	table_sync(client);
+
 	return True;
 }
 
@@ -128,6 +132,8 @@ ewmh_get_net_wm_strut_partial(state_t *state, client_t *client)
 	client->strut.bottom_start_x = ((long *)output)[10];
 	client->strut.bottom_end_x = ((long *)output)[11];
 
+	table_sync(client);
+
 	return True;
 }
 
@@ -345,25 +351,14 @@ ewmh_set_net_active_window(state_t *state, client_t *client)
 void
 ewmh_set_net_client_list(state_t *state)
 {
-	client_t *client;
-	group_t *group;
-	int i, windows_count = 0;
-	screen_t *screen;
+	size_t i;
+	int windows_count = 0;
 	Window *windows;
 
-	TAILQ_FOREACH(screen, &state->screens, entry) {
-		for (i = 0; i < screen->desktop_count; i++) {
-			TAILQ_FOREACH(group, &screen->desktops[i]->groups, entry) {
-				TAILQ_FOREACH(client, &group->clients, entry) {
-					if (windows_count == 0) {
-						windows = calloc(1, sizeof(Window));
-					} else {
-						windows = realloc(windows, (windows_count + 1) * sizeof(Window));
-					}
-
-					windows[windows_count++] = client->window;
-				}
-			}
+	windows = calloc(MAX(table.count, 1), sizeof(Window));
+	for (i = 0; i < table.count; i++) {
+		if (table.clients[i]) {
+			windows[windows_count++] = table.windows[i];
 		}
 	}
 
@@ -377,9 +372,7 @@ ewmh_set_net_client_list(state_t *state)
 			(unsigned char *)windows,
 			windows_count);
 
-	if (windows_count > 0) {
-		free(windows);
-	}
+	free(windows);
 }
 
 void
@@ -712,6 +705,8 @@ ewmh_set_net_wm_state(state_t *state, client_t *client)
 	}
 
 	free(output);
+
+	table_sync(client);
 }
 
 void
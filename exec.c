@@ -0,0 +1,649 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <paths.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+#include "exec.h"
+#include "utils.h"
+
+#define EXEC_DIRENT_BUFFER (64 * 1024)
+
+#ifdef __linux__
+#define EXEC_WATCH_MASK (IN_ATTRIB | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF)
+
+struct linux_dirent64 {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+#endif /* __linux__ */
+
+void exec_append(exec_index_t *, size_t *, const char *);
+Bool exec_cache_path(const char *, char *, size_t);
+exec_dir_t *exec_dir_find(const char *);
+void exec_index_free(exec_index_t *);
+void exec_index_load(const char *, exec_index_t *, struct stat *, Bool);
+Bool exec_index_map(const char *, exec_index_t *, struct stat *);
+void exec_index_scan(const char *, exec_index_t *);
+void exec_index_store(const char *, exec_index_t *, struct stat *);
+void exec_refresh(exec_dir_t *, Bool);
+void *exec_thread(void *);
+void exec_validate(void);
+
+struct exec_dir_q exec_dirs = TAILQ_HEAD_INITIALIZER(exec_dirs);
+
+pthread_mutex_t exec_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_t exec_scanner;
+Bool exec_running = False;
+unsigned long exec_generations = 0;
+int exec_notify = -1;
+int exec_wakeup[2] = { -1, -1 };
+
+void
+exec_append(exec_index_t *index, size_t *capacity, const char *name)
+{
+	size_t length;
+
+	length = strlen(name) + 1;
+	if (index->size + length > *capacity) {
+		*capacity = MAX(*capacity * 2, index->size + length);
+		*capacity = MAX(*capacity, 4096);
+		index->names = realloc(index->names, *capacity);
+	}
+
+	memcpy(index->names + index->size, name, length);
+	index->size += length;
+	index->count++;
+}
+
+Bool
+exec_cache_path(const char *dir, char *buffer, size_t size)
+{
+	char *base, *home;
+	size_t length;
+
+	base = getenv("XDG_CACHE_HOME");
+	if (base && *base) {
+		length = snprintf(buffer, size, "%s/magnetwm", base);
+	} else {
+		home = getenv("HOME");
+		if (!home) {
+			return False;
+		}
+
+		length = snprintf(buffer, size, "%s/.cache/magnetwm", home);
+	}
+
+	if (length + strlen("/exec") >= size) {
+		return False;
+	}
+
+	strcpy(buffer + length, "/exec");
+	length += strlen("/exec");
+
+	if (length + 1 >= size) {
+		return False;
+	}
+
+	buffer[length++] = '/';
+
+	/* encode the directory so that it maps to a single file name */
+	for (; *dir; dir++) {
+		if ((*dir == '/') || (*dir == '%')) {
+			if (length + 3 >= size) {
+				return False;
+			}
+
+			length += sprintf(buffer + length, "%%%02X", (unsigned char)*dir);
+		} else {
+			if (length + 1 >= size) {
+				return False;
+			}
+
+			buffer[length++] = *dir;
+		}
+	}
+
+	buffer[length] = '\0';
+
+	return True;
+}
+
+exec_dir_t *
+exec_dir_find(const char *path)
+{
+	exec_dir_t *dir;
+
+	TAILQ_FOREACH(dir, &exec_dirs, entry) {
+		if (!strcmp(dir->path, path)) {
+			return dir;
+		}
+	}
+
+	dir = calloc(1, sizeof(exec_dir_t));
+	dir->path = strdup(path);
+	dir->watch = -1;
+	dir->index.mtime.tv_sec = -1;
+
+	TAILQ_INSERT_TAIL(&exec_dirs, dir, entry);
+
+	return dir;
+}
+
+void
+exec_foreach(void (*callback)(void *, char *), void *context)
+{
+	char *name;
+	exec_dir_t *dir;
+	size_t i;
+
+	if (exec_running) {
+		pthread_mutex_lock(&exec_lock);
+	} else {
+		exec_validate();
+	}
+
+	TAILQ_FOREACH(dir, &exec_dirs, entry) {
+		name = dir->index.names;
+		for (i = 0; i < dir->index.count; i++) {
+			callback(context, name);
+			name += strlen(name) + 1;
+		}
+	}
+
+	if (exec_running) {
+		pthread_mutex_unlock(&exec_lock);
+	}
+}
+
+void
+exec_free(void)
+{
+	exec_dir_t *dir;
+
+	if (exec_running) {
+		write(exec_wakeup[1], "", 1);
+		pthread_join(exec_scanner, NULL);
+		exec_running = False;
+	}
+
+	if (exec_notify != -1) {
+		close(exec_notify);
+		close(exec_wakeup[0]);
+		close(exec_wakeup[1]);
+		exec_notify = exec_wakeup[0] = exec_wakeup[1] = -1;
+	}
+
+	while ((dir = TAILQ_FIRST(&exec_dirs)) != NULL) {
+		TAILQ_REMOVE(&exec_dirs, dir, entry);
+		exec_index_free(&dir->index);
+		free(dir->path);
+		free(dir);
+	}
+}
+
+/*
+ * Changes whenever the set of indexed names may have changed, so callers
+ * holding on to names can tell when to rebuild.
+ */
+unsigned long
+exec_generation(void)
+{
+	unsigned long generation;
+
+	if (!exec_running) {
+		exec_validate();
+		return exec_generations;
+	}
+
+	pthread_mutex_lock(&exec_lock);
+	generation = exec_generations;
+	pthread_mutex_unlock(&exec_lock);
+
+	return generation;
+}
+
+void
+exec_index_free(exec_index_t *index)
+{
+	if (index->map) {
+		munmap(index->map, index->map_size);
+	} else {
+		free(index->names);
+	}
+
+	memset(index, 0, sizeof(exec_index_t));
+}
+
+void
+exec_index_load(const char *path, exec_index_t *index, struct stat *sb, Bool force)
+{
+	if (force || !exec_index_map(path, index, sb)) {
+		exec_index_scan(path, index);
+		exec_index_store(path, index, sb);
+	}
+
+	index->mtime = sb->st_mtim;
+}
+
+Bool
+exec_index_map(const char *dir, exec_index_t *index, struct stat *sb)
+{
+	char path[PATH_MAX], *name, *end;
+	exec_header_t *header;
+	int fd;
+	size_t count = 0;
+	struct stat cache;
+	void *map;
+
+	if (!exec_cache_path(dir, path, sizeof(path))) {
+		return False;
+	}
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return False;
+	}
+
+	if ((fstat(fd, &cache) == -1) || (cache.st_size < (off_t)sizeof(exec_header_t))) {
+		close(fd);
+		return False;
+	}
+
+	map = mmap(NULL, cache.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return False;
+	}
+
+	header = (exec_header_t *)map;
+	if ((header->magic != EXEC_MAGIC) ||
+			(header->version != EXEC_VERSION) ||
+			(header->mtime_sec != sb->st_mtim.tv_sec) ||
+			(header->mtime_nsec != sb->st_mtim.tv_nsec) ||
+			(header->device != sb->st_dev) ||
+			(header->inode != sb->st_ino) ||
+			(sizeof(exec_header_t) + header->size > (size_t)cache.st_size) ||
+			((header->size > 0) && (((char *)map)[sizeof(exec_header_t) + header->size - 1] != '\0'))) {
+		munmap(map, cache.st_size);
+		return False;
+	}
+
+	/* exec_foreach() walks count names, so they must all be there */
+	name = (char *)map + sizeof(exec_header_t);
+	end = name + header->size;
+	while ((name < end) && (name = memchr(name, '\0', end - name))) {
+		count++;
+		name++;
+	}
+
+	if (count != header->count) {
+		munmap(map, cache.st_size);
+		return False;
+	}
+
+	index->map = map;
+	index->map_size = cache.st_size;
+	index->names = (char *)map + sizeof(exec_header_t);
+	index->count = header->count;
+	index->size = header->size;
+
+	return True;
+}
+
+#ifdef __linux__
+/*
+ * Reads the directory with large getdents64() batches and checks entries
+ * relative to the directory descriptor, so no path is ever built.
+ */
+void
+exec_index_scan(const char *path, exec_index_t *index)
+{
+	char *buffer;
+	int fd;
+	long bytes, offset;
+	size_t capacity = 0;
+	struct linux_dirent64 *dp;
+	struct stat sb;
+
+	fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1) {
+		return;
+	}
+
+	buffer = malloc(EXEC_DIRENT_BUFFER);
+
+	while ((bytes = syscall(SYS_getdents64, fd, buffer, EXEC_DIRENT_BUFFER)) > 0) {
+		for (offset = 0; offset < bytes; offset += dp->d_reclen) {
+			dp = (struct linux_dirent64 *)(buffer + offset);
+
+			if (dp->d_type == DT_UNKNOWN) {
+				if (fstatat(fd, dp->d_name, &sb, AT_SYMLINK_NOFOLLOW) == -1) {
+					continue;
+				}
+
+				if (!S_ISREG(sb.st_mode) && !S_ISLNK(sb.st_mode)) {
+					continue;
+				}
+			} else if (dp->d_type != DT_REG && dp->d_type != DT_LNK) {
+				continue;
+			}
+
+			if (faccessat(fd, dp->d_name, X_OK, 0) != 0) {
+				continue;
+			}
+
+			exec_append(index, &capacity, dp->d_name);
+		}
+	}
+
+	free(buffer);
+	close(fd);
+}
+#else
+void
+exec_index_scan(const char *path, exec_index_t *index)
+{
+	char tpath[PATH_MAX];
+	DIR *dirp;
+	int i;
+	size_t capacity = 0;
+	struct dirent *dp;
+	struct stat sb;
+
+	dirp = opendir(path);
+	if (!dirp) {
+		return;
+	}
+
+	while ((dp = readdir(dirp)) != NULL) {
+		if (dp->d_type != DT_REG && dp->d_type != DT_LNK) {
+			continue;
+		}
+
+		i = snprintf(tpath, PATH_MAX, "%s/%s", path, dp->d_name);
+		if ((i == -1) || (i >= PATH_MAX)) {
+			continue;
+		}
+
+		if (lstat(tpath, &sb) == -1) {
+			continue;
+		}
+
+		if (!S_ISREG(sb.st_mode) && !S_ISLNK(sb.st_mode)) {
+			continue;
+		}
+
+		if (access(tpath, X_OK) != 0) {
+			continue;
+		}
+
+		exec_append(index, &capacity, dp->d_name);
+	}
+
+	closedir(dirp);
+}
+#endif /* __linux__ */
+
+/*
+ * Written to a temporary file and renamed into place, so a concurrent reader
+ * never maps a partially written index.
+ */
+void
+exec_index_store(const char *dir, exec_index_t *index, struct stat *sb)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	exec_header_t header;
+	FILE *stream;
+	int i;
+
+	if (!exec_cache_path(dir, path, sizeof(path))) {
+		return;
+	}
+
+	i = snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+	if ((i == -1) || (i >= (int)sizeof(tmp))) {
+		return;
+	}
+
+	*strrchr(path, '/') = '\0';
+	xmkdir(path);
+	path[strlen(path)] = '/';
+
+	stream = fopen(tmp, "we");
+	if (!stream) {
+		return;
+	}
+
+	memset(&header, 0, sizeof(exec_header_t));
+	header.magic = EXEC_MAGIC;
+	header.version = EXEC_VERSION;
+	header.mtime_sec = sb->st_mtim.tv_sec;
+	header.mtime_nsec = sb->st_mtim.tv_nsec;
+	header.device = sb->st_dev;
+	header.inode = sb->st_ino;
+	header.count = index->count;
+	header.size = index->size;
+
+	if ((fwrite(&header, sizeof(exec_header_t), 1, stream) != 1) ||
+			((index->size > 0) && (fwrite(index->names, index->size, 1, stream) != 1))) {
+		fclose(stream);
+		unlink(tmp);
+		return;
+	}
+
+	if ((fclose(stream) != 0) || (rename(tmp, path) == -1)) {
+		unlink(tmp);
+	}
+}
+
+/*
+ * Runs on the scanner thread. The new index is built without holding the lock
+ * and swapped in afterwards, so exec_foreach() never waits on the filesystem.
+ */
+void
+exec_refresh(exec_dir_t *dir, Bool force)
+{
+	exec_index_t index, old;
+	struct stat sb;
+
+	memset(&index, 0, sizeof(exec_index_t));
+
+	if ((stat(dir->path, &sb) == 0) && S_ISDIR(sb.st_mode)) {
+		if (!force &&
+				(dir->index.mtime.tv_sec == sb.st_mtim.tv_sec) &&
+				(dir->index.mtime.tv_nsec == sb.st_mtim.tv_nsec)) {
+			return;
+		}
+
+		exec_index_load(dir->path, &index, &sb, force);
+	}
+
+	pthread_mutex_lock(&exec_lock);
+	old = dir->index;
+	dir->index = index;
+	exec_generations++;
+	pthread_mutex_unlock(&exec_lock);
+
+	exec_index_free(&old);
+}
+
+Bool
+exec_start(void)
+{
+#ifdef __linux__
+	char *path, *paths, *tofree;
+	exec_dir_t *dir;
+	sigset_t all, previous;
+
+	exec_notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (exec_notify == -1) {
+		return False;
+	}
+
+	if (pipe2(exec_wakeup, O_CLOEXEC) == -1) {
+		close(exec_notify);
+		exec_notify = -1;
+		return False;
+	}
+
+	paths = getenv("PATH");
+	if (!paths) {
+		paths = _PATH_DEFPATH;
+	}
+
+	paths = tofree = strdup(paths);
+
+	while ((path = strsep(&paths, ":")) != NULL) {
+		if (*path) {
+			dir = exec_dir_find(path);
+			dir->dirty = True;
+		}
+	}
+
+	free(tofree);
+
+	/* signals are for the event loop, keep them off the scanner */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &previous);
+	exec_running = (pthread_create(&exec_scanner, NULL, exec_thread, NULL) == 0);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+	if (!exec_running) {
+		close(exec_notify);
+		close(exec_wakeup[0]);
+		close(exec_wakeup[1]);
+		exec_notify = exec_wakeup[0] = exec_wakeup[1] = -1;
+	}
+
+	return exec_running;
+#else
+	return False;
+#endif /* __linux__ */
+}
+
+void *
+exec_thread(void *arg)
+{
+#ifdef __linux__
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	exec_dir_t *dir;
+	long bytes, offset;
+	struct inotify_event *event;
+	struct pollfd descriptors[2];
+
+	descriptors[0].fd = exec_notify;
+	descriptors[0].events = POLLIN;
+	descriptors[1].fd = exec_wakeup[0];
+	descriptors[1].events = POLLIN;
+
+	for (;;) {
+		TAILQ_FOREACH(dir, &exec_dirs, entry) {
+			if (!dir->dirty) {
+				continue;
+			}
+
+			if (dir->watch == -1) {
+				dir->watch = inotify_add_watch(exec_notify, dir->path, EXEC_WATCH_MASK);
+			}
+
+			exec_refresh(dir, dir->index.mtime.tv_sec != -1);
+			dir->dirty = False;
+		}
+
+		if (poll(descriptors, 2, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			break;
+		}
+
+		if (descriptors[1].revents) {
+			break;
+		}
+
+		/* coalesce a burst of events into one rescan per directory */
+		while ((bytes = read(exec_notify, buffer, sizeof(buffer))) > 0) {
+			for (offset = 0; offset < bytes; offset += sizeof(struct inotify_event) + event->len) {
+				event = (struct inotify_event *)(buffer + offset);
+
+				TAILQ_FOREACH(dir, &exec_dirs, entry) {
+					if (dir->watch != event->wd) {
+						continue;
+					}
+
+					if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+						dir->watch = -1;
+					}
+
+					dir->dirty = True;
+				}
+			}
+		}
+	}
+#endif /* __linux__ */
+
+	return NULL;
+}
+
+/* On-demand counterpart of the scanner thread: one stat() per $PATH entry. */
+void
+exec_validate(void)
+{
+	char *path, *paths, *tofree;
+	exec_dir_t *dir;
+	struct stat sb;
+
+	paths = getenv("PATH");
+	if (!paths) {
+		paths = _PATH_DEFPATH;
+	}
+
+	paths = tofree = strdup(paths);
+
+	while ((path = strsep(&paths, ":")) != NULL) {
+		if (!*path) {
+			continue;
+		}
+
+		dir = exec_dir_find(path);
+
+		if ((stat(path, &sb) == -1) || !S_ISDIR(sb.st_mode)) {
+			if (dir->index.mtime.tv_sec != -1) {
+				exec_index_free(&dir->index);
+				dir->index.mtime.tv_sec = -1;
+				exec_generations++;
+			}
+
+			continue;
+		}
+
+		if ((dir->index.mtime.tv_sec != sb.st_mtim.tv_sec) || (dir->index.mtime.tv_nsec != sb.st_mtim.tv_nsec)) {
+			exec_index_free(&dir->index);
+			exec_index_load(dir->path, &dir->index, &sb, False);
+			exec_generations++;
+		}
+	}
+
+	free(tofree);
+}
@@ -0,0 +1,67 @@
+#ifndef __EXEC_H__
+#define __EXEC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <X11/Xlib.h>
+
+#include "queue.h"
+
+/*
+ * Index of the executables found in each $PATH directory. Every directory's
+ * list of names is persisted under $XDG_CACHE_HOME/magnetwm/exec and tagged
+ * with the directory's mtime; a directory is only rescanned when its mtime no
+ * longer matches, otherwise the cache file is mapped as is.
+ *
+ * Once exec_start() succeeds, a background thread owns the scanning: it
+ * builds every index at startup and refreshes directories reported by
+ * inotify, so exec_foreach() only reads memory. Without it, exec_foreach()
+ * validates each directory itself.
+ */
+
+#define EXEC_MAGIC 0x4d57584d
+#define EXEC_VERSION 1
+
+TAILQ_HEAD(exec_dir_q, exec_dir_t);
+
+typedef struct exec_header_t {
+	uint32_t magic;
+	uint32_t version;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t device;
+	uint64_t inode;
+	uint32_t count;
+	uint32_t size;
+} exec_header_t;
+
+typedef struct exec_index_t {
+	struct timespec mtime;
+
+	/* count NUL-terminated names, size bytes in total */
+	char *names;
+	size_t count;
+	size_t size;
+
+	void *map;
+	size_t map_size;
+} exec_index_t;
+
+typedef struct exec_dir_t {
+	TAILQ_ENTRY(exec_dir_t) entry;
+
+	char *path;
+	int watch;
+	Bool dirty;
+
+	exec_index_t index;
+} exec_dir_t;
+
+void exec_foreach(void (*)(void *, char *), void *);
+void exec_free(void);
+unsigned long exec_generation(void);
+Bool exec_start(void);
+
+#endif /* __EXEC_H__ */
@@ -1,5 +1,3 @@
-#include <dirent.h>
-#include <paths.h>
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
@@ -9,6 +7,8 @@
 #include "client.h"
 #include "config.h"
 #include "desktop.h"
+#include "drag.h"
+#include "exec.h"
 #include "functions.h"
 #include "group.h"
 #include "menu.h"
@@ -20,6 +20,22 @@
 
 extern sig_atomic_t wm_state;
 
+/*
+ * Sets or clears the preview mark of a client. The flag doubles as the set
+ * marked so far: only a client whose mark changes has its border redrawn, so
+ * moving the selection costs requests for the two affected entries only.
+ */
+void
+function_client_mark(state_t *state, client_t *client, Bool mark)
+{
+	if (((client->flags & CLIENT_MARK) != 0) == mark) {
+		return;
+	}
+
+	client->flags ^= CLIENT_MARK;
+	client_draw_border(state, client);
+}
+
 void
 function_group_cycle_callback(state_t *state, void *context)
 {
@@ -29,16 +45,31 @@ function_group_cycle_callback(state_t *state, void *context)
 	group = (group_t *)context;
 
 	TAILQ_FOREACH(current, &group->desktop->groups, entry) {
-		if (current == group) {
-			TAILQ_FOREACH(client, &current->clients, entry) {
-				client->flags |= CLIENT_MARK;
-				client_draw_border(state, client);
-			}
-		} else {
-			TAILQ_FOREACH(client, &current->clients, entry) {
-				client->flags &= ~CLIENT_MARK;
-				client_draw_border(state, client);
-			}
+		TAILQ_FOREACH(client, &current->clients, entry) {
+			function_client_mark(state, client, current == group);
+		}
+	}
+}
+
+void
+function_group_cycle_select(state_t *state, menu_t *menu, void *context)
+{
+	client_t *client;
+	desktop_t *desktop;
+	group_t *current, *group = (group_t *)context;
+
+	desktop = menu->screen->desktops[menu->screen->desktop_index];
+
+	TAILQ_FOREACH(current, &desktop->groups, entry) {
+		TAILQ_FOREACH(client, &current->clients, entry) {
+			function_client_mark(state, client, False);
+		}
+	}
+
+	if (group) {
+		current = TAILQ_LAST(&desktop->groups, group_q);
+		if (current != group) {
+			group_activate(state, group);
 		}
 	}
 }
@@ -49,21 +80,21 @@ function_group_cycle(state_t *state, void *context, long flag)
 	char detail[BUFSIZ];
 	client_t *client;
 	desktop_t *desktop;
-	group_t *current, *group;
-	int hidden, visible;
+	group_t *group;
+	int activatable, hidden, visible;
 	menu_t *menu;
 	screen_t *screen = (screen_t *)context;
 
 	desktop = screen->desktops[screen->desktop_index];
-	menu = menu_init(state, screen, NULL, True, function_group_cycle_callback);
+	menu = menu_init(state, screen, NULL, True, function_group_cycle_callback, function_group_cycle_select);
 
 	TAILQ_FOREACH_REVERSE(group, &desktop->groups, group_q, entry) {
-		if (!group_can_activate(group)) {
-			continue;
-		}
-
-		hidden = visible = 0;
+		activatable = hidden = visible = 0;
 		TAILQ_FOREACH(client, &group->clients, entry) {
+			if (!(client->flags & CLIENT_IGNORE)) {
+				activatable++;
+			}
+
 			if (client->flags & CLIENT_HIDDEN) {
 				hidden++;
 			} else {
@@ -71,7 +102,7 @@ function_group_cycle(state_t *state, void *context, long flag)
 			}
 		}
 
-		if (hidden + visible > 0) {
+		if (activatable > 0) {
 			if (hidden > 0) {
 				if (visible > 0) {
 					sprintf(detail, "(%d visible, %d hidden)", hidden, visible);
@@ -85,23 +116,17 @@ function_group_cycle(state_t *state, void *context, long flag)
 		}
 	}
 
-	group = (group_t *)menu_filter(menu);
+	menu_open(menu);
+}
 
-	TAILQ_FOREACH(current, &desktop->groups, entry) {
-		TAILQ_FOREACH(client, &current->clients, entry) {
-			client->flags &= ~CLIENT_MARK;
-			client_draw_border(state, client);
-		}
-	}
+void
+function_menu_command_select(state_t *state, menu_t *menu, void *context)
+{
+	command_t *command = (command_t *)context;
 
-	if (group) {
-		current = TAILQ_LAST(&desktop->groups, group_q);
-		if (current != group) {
-			group_activate(state, group);
-		}
+	if (command) {
+		xspawn(command->path);
 	}
-
-	menu_free(menu);
 }
 
 void
@@ -111,82 +136,75 @@ function_menu_command(state_t *state, void *context, long flag)
 	menu_t *menu;
 	screen_t *screen = (screen_t *)context;
 
-	menu = menu_init(state, screen, state->config->labels[LABEL_APPLICATIONS], False, NULL);
+	menu = state->menus[MENU_COMMAND];
+	if (!menu) {
+		menu = menu_init(
+				state,
+				screen,
+				state->config->labels[LABEL_APPLICATIONS],
+				False,
+				NULL,
+				function_menu_command_select);
+		menu->persistent = True;
+		menu->history = "command";
+
+		TAILQ_FOREACH(command, &state->config->commands, entry) {
+			menu_add(menu, command, 1, command->name, NULL);
+		}
 
-	TAILQ_FOREACH(command, &state->config->commands, entry) {
-		menu_add(menu, command, 1, command->name, NULL);
+		state->menus[MENU_COMMAND] = menu;
 	}
 
-	command = (command_t *)menu_filter(menu);
+	menu->screen = screen;
+	menu_open(menu);
+}
 
-	if (command) {
-		xspawn(command->path);
+void
+function_menu_exec_select(state_t *state, menu_t *menu, void *context)
+{
+	if (context) {
+		xspawn((char *)context);
 	}
+}
+
+void
+function_menu_exec_add(void *context, char *name)
+{
+	menu_item_t *item;
+	menu_t *menu = (menu_t *)context;
 
-	menu_free(menu);
+	item = menu_add(menu, NULL, 1, name, NULL);
+	item->context = item->text;
 }
 
 void
 function_menu_exec(state_t *state, void *context, long flag)
 {
-	char *path, *paths, tpath[PATH_MAX];
-	DIR *dirp;
-	int i;
 	menu_t *menu;
 	screen_t *screen = (screen_t *)context;
-	struct dirent *dp;
-	struct stat sb;
+	unsigned long generation;
 
-	menu = menu_init(state, screen, state->config->labels[LABEL_RUN], False, NULL);
+	generation = exec_generation();
 
-	paths = getenv("PATH");
-	if (!paths) {
-		paths = _PATH_DEFPATH;
+	menu = state->menus[MENU_EXEC];
+	if (menu && (menu->generation != generation) && (state->menu != menu)) {
+		menu_free(menu);
+		menu = state->menus[MENU_EXEC] = NULL;
 	}
 
-	paths = strdup(paths);
+	if (!menu) {
+		menu = menu_init(state, screen, state->config->labels[LABEL_RUN], False, NULL, function_menu_exec_select);
+		menu->persistent = True;
+		menu->history = "exec";
+		menu->generation = generation;
 
-	while ((path = strsep(&paths, ":")) != NULL) {
-		dirp = opendir(path);
-		if (!dirp) {
-			continue;
-		}
-
-		while ((dp = readdir(dirp)) != NULL) {
-			if (dp->d_type != DT_REG && dp->d_type != DT_LNK) {
-				continue;
-			}
-
-			memset(tpath, '\0', PATH_MAX);
-			i = snprintf(tpath, PATH_MAX, "%s/%s", path, dp->d_name);
-			if ((i == -1) || (i >= PATH_MAX)) {
-				continue;
-			}
-
-			if (lstat(tpath, &sb) == -1) {
-				continue;
-			}
-
-			if (!S_ISREG(sb.st_mode) && !S_ISLNK(sb.st_mode)) {
-				continue;
-			}
+		exec_foreach(function_menu_exec_add, menu);
 
-			if (access(tpath, X_OK) == 0) {
-				menu_add(menu, dp, 1, dp->d_name, NULL);
-			}
-		}
-
-		closedir(dirp);
-	}
-
-	dp = (struct dirent *)menu_filter(menu);
-
-	if (dp) {
-		xspawn(dp->d_name);
+		state->menus[MENU_EXEC] = menu;
 	}
 
-	menu_free(menu);
-	free(paths);
+	menu->screen = screen;
+	menu_open(menu);
 }
 
 void
@@ -197,29 +215,52 @@ function_menu_windows_callback(state_t *state, void *context)
 	client = (client_t *)context;
 
 	TAILQ_FOREACH(current, &client->group->clients, entry) {
-		if (current == client) {
-			current->flags |= CLIENT_MARK;
-		} else {
-			current->flags &= ~CLIENT_MARK;
+		function_client_mark(state, current, current == client);
+	}
+}
+
+void
+function_menu_windows_select(state_t *state, menu_t *menu, void *context)
+{
+	client_t *client = (client_t *)context, *current;
+	desktop_t *desktop;
+	group_t *group;
+
+	desktop = menu->screen->desktops[menu->screen->desktop_index];
+
+	TAILQ_FOREACH(group, &desktop->groups, entry) {
+		TAILQ_FOREACH(current, &group->clients, entry) {
+			function_client_mark(state, current, False);
 		}
+	}
 
-		client_draw_border(state, current);
+	if (client) {
+		if (client->flags & CLIENT_HIDDEN) {
+			client_show(state, client);
+		}
+
+		client_raise(state, client);
+		client_activate(state, client, True);
 	}
 }
 
 void
 function_menu_windows(state_t *state, void *context, long flag)
 {
-	client_t *client, *current;
-	group_t *group;
+	client_t *client;
 	menu_t *menu;
 	screen_t *screen;
 
 	client = (client_t *)context;
-	group = client->group;
 
 	screen = client->group->desktop->screen;
-	menu = menu_init(state, screen, state->config->labels[LABEL_WINDOWS], False, function_menu_windows_callback);
+	menu = menu_init(
+			state,
+			screen,
+			state->config->labels[LABEL_WINDOWS],
+			False,
+			function_menu_windows_callback,
+			function_menu_windows_select);
 
 	TAILQ_FOREACH_REVERSE(client, &client->group->clients, client_q, entry) {
 		if (client->type != CLIENT_TYPE_NORMAL) {
@@ -235,23 +276,7 @@ function_menu_windows(state_t *state, void *context, long flag)
 		}
 	}
 
-	client = (client_t *)menu_filter(menu);
-
-	TAILQ_FOREACH(current, &group->clients, entry) {
-		current->flags &= ~CLIENT_MARK;
-		client_draw_border(state, current);
-	}
-
-	if (client) {
-		if (client->flags & CLIENT_HIDDEN) {
-			client_show(state, client);
-		}
-
-		client_raise(state, client);
-		client_activate(state, client, True);
-	}
-
-	menu_free(menu);
+	menu_open(menu);
 }
 
 void
@@ -270,7 +295,7 @@ void
 function_window_center(struct state_t *state, void *context, long flag)
 {
 	client_t *client = (client_t *)context;
-	geometry_t screen_area;
+	geometry_t from = client->geometry, screen_area;
 	screen_t *screen;
 
 	screen = client->group->desktop->screen;
@@ -281,7 +306,7 @@ function_window_center(struct state_t *state, void *context, long flag)
 	client->geometry.x = screen_area.x + (screen_area.width - client->geometry.width) / 2 - client->border_width;
 	client->geometry.y = screen_area.y + (screen_area.height - client->geometry.height) / 2 - client->border_width;
 
-	client_move_resize(state, client, True);
+	client_transition(state, client, from, True);
 }
 
 void
@@ -342,78 +367,15 @@ void
 function_window_move(struct state_t *state, void *context, long flag)
 {
 	client_t *client = (client_t *)context;
-	geometry_t screen_area;
-	int move = 1, result, x, y;
-	screen_t *screen;
-	Time time = 0;
-	XEvent event;
 
-	if (!x_get_pointer(state->display, client->window, &x, &y)) {
-		return;
-	}
-
-	result = XGrabPointer(
-			state->display,
-			client->window,
-			False,
-			ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
-			GrabModeAsync,
-			GrabModeAsync,
-			None,
-			state->cursors[CURSOR_MOVE],
-			CurrentTime);
-	if (result != GrabSuccess) {
-		return;
-	}
-
-	client->geometry_saved = client->geometry;
-
-	screen = client->group->desktop->screen;
-	screen_area = screen_available_area(screen);
-
-	while (move) {
-		XMaskEvent(state->display, ButtonPressMask | ButtonReleaseMask | PointerMotionMask, &event);
-		switch (event.type) {
-			case MotionNotify:
-				if (event.xmotion.time - time <= 1000 / 60) {
-					continue;
-				}
-
-				time = event.xmotion.time;
-
-				client->geometry.x += event.xmotion.x_root - x;
-				client->geometry.y += event.xmotion.y_root - y;
-				if (client->geometry.y < screen_area.y) {
-					client->geometry.y = screen_area.y;
-				}
-
-				x = event.xmotion.x_root;
-				y = event.xmotion.y_root;
-
-				client_move_resize(state, client, True);
-
-				break;
-			case ButtonRelease:
-				move = 0;
-				break;
-		}
-	}
-
-	XUngrabPointer(state->display, CurrentTime);
-
-	screen = screen_for_client(state, client);
-	if (screen != client->group->desktop->screen) {
-		screen_adopt(state, screen, client);
-	}
-
-	XFlush(state->display);
+	drag_begin(state, client, DRAG_MOVE);
 }
 
 void
 function_window_move_to_screen(struct state_t *state, void *context, long flag)
 {
 	client_t *client = (client_t *)context;
-	geometry_t screen_area_new, screen_area_old;
+	geometry_t from = client->geometry, screen_area_new, screen_area_old;
 	screen_t *screen = NULL;
 
 	if (flag == DIRECTION_UP) {
@@ -433,7 +395,7 @@ function_window_move_to_screen(struct state_t *state, void *context, long flag)
 		client->geometry.x = screen_area_new.x + (client->geometry.x - screen_area_old.x);
 		client->geometry.y = screen_area_new.y + (client->geometry.y - screen_area_old.y);
 
-		client_move_resize(state, client, False);
+		client_transition(state, client, from, False);
 		screen_adopt(state, screen, client);
 	}
 }
@@ -442,73 +404,8 @@ void
 function_window_resize(struct state_t *state, void *context, long flag)
 {
 	client_t *client = (client_t *)context;
-	Cursor cursor;
-	int resize = 1, original_height, original_width, result, x, y;
-	Time time = 0;
-	XEvent event;
-
-	if (!x_get_pointer(state->display, client->window, &x, &y)) {
-		return;
-	}
-
-	if (x < client->geometry.x + client->geometry.width / 2) {
-		if (y < client->geometry.y + client->geometry.height / 2) {
-			cursor = state->cursors[CURSOR_RESIZE_TOP_LEFT];
-		} else {
-			cursor = state->cursors[CURSOR_RESIZE_BOTTOM_LEFT];
-		}
-	} else {
-		if (y < client->geometry.y + client->geometry.height / 2) {
-			cursor = state->cursors[CURSOR_RESIZE_TOP_RIGHT];
-		} else {
-			cursor = state->cursors[CURSOR_RESIZE_BOTTOM_RIGHT];
-		}
-	}
-
-	result = XGrabPointer(
-			state->display,
-			client->window,
-			False,
-			ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
-			GrabModeAsync,
-			GrabModeAsync,
-			None,
-			cursor,
-			CurrentTime);
-	if (result != GrabSuccess) {
-		return;
-	}
-
-	original_width = client->geometry.width;
-	original_height = client->geometry.height;
-	
-	client->geometry_saved = client->geometry;
-
-	while (resize) {
-		XMaskEvent(state->display, ButtonPressMask | ButtonReleaseMask | PointerMotionMask, &event);
-		switch (event.type) {
-			case MotionNotify:
-				if (event.xmotion.time - time <= 1000 / 60) {
-					continue;
-				}
-
-				time = event.xmotion.time;
-
-				client->geometry.width = original_width + event.xmotion.x_root - x;
-				client->geometry.height = original_height + event.xmotion.y_root - y;
-
-				client_apply_size_hints(state, client);
-				client_move_resize(state, client, True);
-
-				break;
-			case ButtonRelease:
-				resize = 0;
-				break;
-		}
-	}
 
-	XUngrabPointer(state->display, CurrentTime);
-	XFlush(state->display);
+	drag_begin(state, client, DRAG_RESIZE);
 }
 
 void
@@ -527,7 +424,7 @@ void
 function_window_tile(state_t *state, void *context, long flag)
 {
 	client_t *client = (client_t *)context;
-	geometry_t screen_area;
+	geometry_t from = client->geometry, screen_area;
 	screen_t *screen;
 
 	screen = client->group->desktop->screen;
@@ -570,7 +467,7 @@ function_window_tile(state_t *state, void *context, long flag)
 	}
 
 	client_apply_size_hints(state, client);
-	client_move_resize(state, client, True);
+	client_transition(state, client, from, True);
 }
 
 void
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "glyph.h"
+#include "utils.h"
+
+#define GLYPH_INITIAL_SIZE 64
+
+glyph_cache_t *glyph_cache(XftFont *);
+int glyph_decode(const FcChar8 *, FcChar32 *, int);
+glyph_metrics_t *glyph_lookup(Display *, glyph_cache_t *, FcChar32);
+void glyph_resize(glyph_cache_t *, size_t);
+
+glyph_cache_t *glyph_caches = NULL;
+
+void
+glyph_free(void)
+{
+	glyph_cache_t *cache;
+
+	while ((cache = glyph_caches) != NULL) {
+		glyph_caches = cache->next;
+		free(cache->table);
+		free(cache);
+	}
+}
+
+/*
+ * Lays the text out like XftDrawStringUtf8() would with its origin at x, y.
+ * specs must have room for strlen(text) glyphs; returns how many were used.
+ */
+int
+glyph_layout(Display *display, XftFont *font, const char *text, int x, int y, XftGlyphFontSpec *specs)
+{
+	const FcChar8 *s = (const FcChar8 *)text;
+	glyph_cache_t *cache;
+	glyph_metrics_t *metrics;
+	FcChar32 code;
+	int count = 0, length, n;
+
+	cache = glyph_cache(font);
+	length = strlen(text);
+
+	while ((length > 0) && ((n = glyph_decode(s, &code, length)) > 0)) {
+		s += n;
+		length -= n;
+
+		metrics = glyph_lookup(display, cache, code);
+		specs[count].font = font;
+		specs[count].glyph = metrics->index;
+		specs[count].x = x;
+		specs[count].y = y;
+		count++;
+
+		x += metrics->advance;
+	}
+
+	return count;
+}
+
+/*
+ * Returns the ink width XftTextExtentsUtf8() reports for the text, combining
+ * the glyph boxes the same way: the text stops at the first invalid UTF-8
+ * sequence and each glyph's box is placed at the pen position so far.
+ */
+int
+glyph_width(Display *display, XftFont *font, const char *text)
+{
+	const FcChar8 *s = (const FcChar8 *)text;
+	glyph_cache_t *cache;
+	glyph_metrics_t *metrics;
+	FcChar32 code;
+	int length, n, x = 0, left = 0, right = 0, first = 1;
+
+	cache = glyph_cache(font);
+	length = strlen(text);
+
+	while (length > 0) {
+		if ((*s < 0x80) && cache->dense[*s].loaded) {
+			metrics = &cache->dense[*s];
+			s++;
+			length--;
+		} else {
+			if ((n = glyph_decode(s, &code, length)) <= 0) {
+				break;
+			}
+
+			s += n;
+			length -= n;
+
+			metrics = glyph_lookup(display, cache, code);
+		}
+		if (first) {
+			left = x - metrics->x;
+			right = left + metrics->width;
+			first = 0;
+		} else {
+			left = MIN(left, x - metrics->x);
+			right = MAX(right, x - metrics->x + metrics->width);
+		}
+
+		x += metrics->advance;
+	}
+
+	return right - left;
+}
+
+glyph_cache_t *
+glyph_cache(XftFont *font)
+{
+	glyph_cache_t *cache;
+
+	for (cache = glyph_caches; cache; cache = cache->next) {
+		if (cache->font == font) {
+			return cache;
+		}
+	}
+
+	cache = calloc(1, sizeof(glyph_cache_t));
+	cache->font = font;
+	cache->next = glyph_caches;
+	glyph_caches = cache;
+
+	return cache;
+}
+
+/*
+ * Decodes UTF-8 with the rules of fontconfig's FcUtf8ToUcs4(), which Xft uses,
+ * returning the length of the sequence or -1. Linking fontconfig for it alone
+ * is not worth it.
+ */
+int
+glyph_decode(const FcChar8 *s, FcChar32 *code, int length)
+{
+	FcChar32 c = *s;
+	int extra, i;
+
+	if (c < 0x80) {
+		*code = c;
+		return 1;
+	} else if ((c & 0xe0) == 0xc0) {
+		c &= 0x1f;
+		extra = 1;
+	} else if ((c & 0xf0) == 0xe0) {
+		c &= 0x0f;
+		extra = 2;
+	} else if ((c & 0xf8) == 0xf0) {
+		c &= 0x07;
+		extra = 3;
+	} else if ((c & 0xfc) == 0xf8) {
+		c &= 0x03;
+		extra = 4;
+	} else if ((c & 0xfe) == 0xfc) {
+		c &= 0x01;
+		extra = 5;
+	} else {
+		return -1;
+	}
+
+	if (extra >= length) {
+		return -1;
+	}
+
+	for (i = 1; i <= extra; i++) {
+		if ((s[i] & 0xc0) != 0x80) {
+			return -1;
+		}
+
+		c = (c << 6) | (s[i] & 0x3f);
+	}
+
+	*code = c;
+
+	return extra + 1;
+}
+
+/* Returns the metrics of the code point, asking Xft on first use. */
+glyph_metrics_t *
+glyph_lookup(Display *display, glyph_cache_t *cache, FcChar32 code)
+{
+	glyph_metrics_t *metrics;
+	glyph_entry_t *entry = NULL;
+	XGlyphInfo extents;
+	size_t i;
+
+	if (code < GLYPH_DENSE) {
+		metrics = &cache->dense[code];
+	} else {
+		if (cache->count >= cache->size * 3 / 4) {
+			glyph_resize(cache, cache->size ? cache->size * 2 : GLYPH_INITIAL_SIZE);
+		}
+
+		for (i = code & (cache->size - 1); ; i = (i + 1) & (cache->size - 1)) {
+			entry = &cache->table[i];
+			if ((entry->code == code) || (entry->code == 0)) {
+				break;
+			}
+		}
+
+		metrics = &entry->metrics;
+	}
+
+	if (!metrics->loaded) {
+		metrics->index = XftCharIndex(display, cache->font, code);
+		XftGlyphExtents(display, cache->font, &metrics->index, 1, &extents);
+		metrics->x = extents.x;
+		metrics->width = extents.width;
+		metrics->advance = extents.xOff;
+		metrics->loaded = 1;
+
+		if (entry) {
+			entry->code = code;
+			cache->count++;
+		}
+	}
+
+	return metrics;
+}
+
+void
+glyph_resize(glyph_cache_t *cache, size_t size)
+{
+	glyph_entry_t *table = cache->table;
+	size_t i, j, old = cache->size;
+
+	cache->table = calloc(size, sizeof(glyph_entry_t));
+	cache->size = size;
+
+	for (i = 0; i < old; i++) {
+		if (table[i].code == 0) {
+			continue;
+		}
+
+		for (j = table[i].code & (size - 1); cache->table[j].code; j = (j + 1) & (size - 1));
+		cache->table[j] = table[i];
+	}
+
+	free(table);
+}
@@ -0,0 +1,45 @@
+#ifndef __GLYPH_H__
+#define __GLYPH_H__
+
+#include <X11/Xft/Xft.h>
+
+/*
+ * Per-font cache of glyph metrics for measuring text without asking Xft for
+ * every string. Xft neither shapes nor kerns, so a string's extents follow
+ * from the metrics of its characters alone and the cached sum is exact. The
+ * cache also holds glyph indices, so text can be laid out for
+ * XftDrawGlyphFontSpec() and drawn in batches.
+ */
+
+/* Code points below this are kept in a flat array, the rest are hashed. */
+#define GLYPH_DENSE 0x800
+
+typedef struct glyph_metrics_t {
+	FT_UInt index;
+	short x;
+	short width;
+	short advance;
+	short loaded;
+} glyph_metrics_t;
+
+typedef struct glyph_entry_t {
+	FcChar32 code;
+	glyph_metrics_t metrics;
+} glyph_entry_t;
+
+typedef struct glyph_cache_t {
+	struct glyph_cache_t *next;
+	XftFont *font;
+
+	glyph_metrics_t dense[GLYPH_DENSE];
+
+	glyph_entry_t *table;
+	size_t count;
+	size_t size;
+} glyph_cache_t;
+
+void glyph_free(void);
+int glyph_layout(Display *, XftFont *, const char *, int, int, XftGlyphFontSpec *);
+int glyph_width(Display *, XftFont *, const char *);
+
+#endif /* __GLYPH_H__ */
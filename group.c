@@ -4,7 +4,16 @@
 #include "client.h"
 #include "desktop.h"
 #include "group.h"
+#include "intern.h"
+#include "menu.h"
+#include "pool.h"
 #include "state.h"
+#include "table.h"
+
+void group_hash_insert(group_t *);
+void group_hash_remove(group_t *);
+
+static pool_t group_pool = POOL_INITIALIZER("group", group_t, 32);
 
 void
 group_activate(state_t *state, group_t *group)
@@ -31,21 +40,26 @@ group_assign(desktop_t *desktop, client_t *client)
 {
 	group_t *group;
 
-	TAILQ_FOREACH(group, &desktop->groups, entry) {
-		if (strcmp(group->name, client->class_name) == 0) {
+	group = desktop->group_table[INTERN_HASH_POINTER(client->class_name, DESKTOP_GROUP_BUCKETS)];
+	for (; group; group = group->hash_next) {
+		if (group->name == client->class_name) {
 			TAILQ_INSERT_TAIL(&group->clients, client, entry);
 			client->group = group;
+			table_sync(client);
 			return group;
 		}
 	}
 
-	group = calloc(1, sizeof(group_t));
-	group->name = strdup(client->class_name);
+	group = pool_alloc(&group_pool);
+	group->name = intern_retain(client->class_name);
+	group->desktop = desktop;
 	TAILQ_INIT(&group->clients);
 	TAILQ_INSERT_TAIL(&group->clients, client, entry);
 	client->group = group;
 
 	TAILQ_INSERT_TAIL(&desktop->groups, group, entry);
+	group_hash_insert(group);
+	table_sync(client);
 
 	return group;
 }
@@ -88,7 +102,32 @@ group_free(group_t *group)
 		client_free(client);
 	}
 
-	free(group->name);
+	intern_release(group->name);
+	pool_free(&group_pool, group);
+}
+
+void
+group_hash_insert(group_t *group)
+{
+	group_t **bucket;
+
+	bucket = &group->desktop->group_table[INTERN_HASH_POINTER(group->name, DESKTOP_GROUP_BUCKETS)];
+	group->hash_next = *bucket;
+	*bucket = group;
+}
+
+void
+group_hash_remove(group_t *group)
+{
+	group_t **link;
+
+	link = &group->desktop->group_table[INTERN_HASH_POINTER(group->name, DESKTOP_GROUP_BUCKETS)];
+	for (; *link; link = &(*link)->hash_next) {
+		if (*link == group) {
+			*link = group->hash_next;
+			return;
+		}
+	}
 }
 
 void
@@ -104,7 +143,16 @@ group_map(state_t *state, group_t *group)
 }
 
 void
-group_unassign(client_t *client)
+group_rename(group_t *group, char *name)
+{
+	group_hash_remove(group);
+	intern_release(group->name);
+	group->name = intern(name);
+	group_hash_insert(group);
+}
+
+void
+group_unassign(state_t *state, client_t *client)
 {
 	if (!client->group) {
 		return;
@@ -112,11 +160,17 @@ group_unassign(client_t *client)
 
 	TAILQ_REMOVE(&client->group->clients, client, entry);
 	if (TAILQ_EMPTY(&client->group->clients)) {
+		if (state->menu) {
+			menu_remove(state->menu, client->group);
+		}
+
 		TAILQ_REMOVE(&client->group->desktop->groups, client->group, entry);
+		group_hash_remove(client->group);
 		group_free(client->group);
 	}
 
 	client->group = NULL;
+	table_sync(client);
 }
 
 void
@@ -11,7 +11,9 @@ TAILQ_HEAD(client_q, client_t);
 
 typedef struct group_t {
 	TAILQ_ENTRY(group_t) entry;
+	struct group_t *hash_next;
 
+	/* interned */
 	char *name;
 
 	struct desktop_t *desktop;
@@ -24,7 +26,8 @@ Bool group_can_activate(group_t *);
 void group_deactivate(struct state_t *, group_t *);
 void group_free(group_t *);
 void group_map(struct state_t *, group_t *);
-void group_unassign(struct client_t *);
+void group_rename(group_t *, char *);
+void group_unassign(struct state_t *, struct client_t *);
 void group_unmap(struct state_t *, group_t *);
 
 #endif /* __GROUP_H__ */
@@ -0,0 +1,352 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+
+#include "history.h"
+#include "utils.h"
+
+#define HISTORY_INITIAL_CAPACITY 1024
+
+uint32_t history_check(history_record_t *);
+history_record_t *history_find(uint64_t, Bool);
+void history_grow(void);
+uint64_t history_hash(const char *, const char *);
+Bool history_map(int, uint32_t, Bool);
+Bool history_open(void);
+Bool history_path(char *, size_t);
+void history_unmap(void);
+
+history_header_t *history = NULL;
+history_record_t *history_records = NULL;
+size_t history_count = 0;
+int history_fd = -1;
+Bool history_tried = False;
+
+void
+history_free(void)
+{
+	history_unmap();
+	history_tried = False;
+}
+
+double
+history_rank(const char *space, const char *name)
+{
+	history_record_t *record;
+
+	if (!history_open()) {
+		return 0;
+	}
+
+	record = history_find(history_hash(space, name), False);
+
+	return record ? record->rank : 0;
+}
+
+/* Records a launch and returns the entry's new rank. */
+double
+history_record(const char *space, const char *name)
+{
+	history_record_t *record, update;
+	uint64_t hash;
+	double now;
+
+	if (!history_open()) {
+		return 0;
+	}
+
+	hash = history_hash(space, name);
+	record = history_find(hash, False);
+	if (!record) {
+		if ((history_count + 1) * 4 > history->capacity * 3) {
+			history_grow();
+		}
+
+		record = history_find(hash, True);
+		if (!record) {
+			return 0;
+		}
+
+		history_count++;
+	}
+
+	now = (double)time(NULL) / HISTORY_HALF_LIFE;
+
+	memset(&update, 0, sizeof(history_record_t));
+	update.hash = hash;
+	update.time = time(NULL);
+	if (record->hash == hash) {
+		update.rank = log2(exp2(record->rank - now) + 1) + now;
+		update.count = record->count + 1;
+	} else {
+		update.rank = now;
+		update.count = 1;
+	}
+
+	update.check = history_check(&update);
+	memcpy(record, &update, sizeof(history_record_t));
+
+	return update.rank;
+}
+
+uint32_t
+history_check(history_record_t *record)
+{
+	const unsigned char *p = (const unsigned char *)record;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < offsetof(history_record_t, check); i++) {
+		hash = (hash ^ p[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Probes for the record with the given hash. Unless create is set, a missing
+ * record yields NULL; otherwise the free slot it would go to is returned.
+ */
+history_record_t *
+history_find(uint64_t hash, Bool create)
+{
+	history_record_t *record;
+	uint32_t i, n, mask;
+
+	mask = history->capacity - 1;
+	for (i = hash & mask, n = 0; n < history->capacity; i = (i + 1) & mask, n++) {
+		record = &history_records[i];
+		if (record->hash == 0) {
+			return create ? record : NULL;
+		}
+
+		if ((record->hash == hash) && (record->check == history_check(record))) {
+			return record;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Rehashes the table into a file twice the size, written aside and renamed
+ * into place, so a crash leaves either the old or the new table.
+ */
+void
+history_grow(void)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	history_header_t *old;
+	history_record_t *records, *record;
+	size_t size;
+	uint32_t capacity, i;
+	int fd;
+
+	if (!history_path(path, sizeof(path))) {
+		return;
+	}
+
+	i = snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+	if (i >= sizeof(tmp)) {
+		return;
+	}
+
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		return;
+	}
+
+	old = history;
+	records = history_records;
+	capacity = history->capacity;
+	size = sizeof(history_header_t) + capacity * sizeof(history_record_t);
+	history = NULL;
+
+	if (!history_map(fd, capacity * 2, True)) {
+		history = old;
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+
+	history_count = 0;
+	for (i = 0; i < capacity; i++) {
+		if ((records[i].hash == 0) || (records[i].check != history_check(&records[i]))) {
+			continue;
+		}
+
+		record = history_find(records[i].hash, True);
+		if (record) {
+			memcpy(record, &records[i], sizeof(history_record_t));
+			history_count++;
+		}
+	}
+
+	if ((msync(history, sizeof(history_header_t) + history->capacity * sizeof(history_record_t), MS_SYNC) == -1) ||
+			(rename(tmp, path) == -1)) {
+		unlink(tmp);
+	}
+
+	munmap(old, size);
+	close(history_fd);
+	history_fd = fd;
+}
+
+uint64_t
+history_hash(const char *space, const char *name)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	for (; *space; space++) {
+		hash = (hash ^ (unsigned char)*space) * 1099511628211ull;
+	}
+
+	hash = (hash ^ 0) * 1099511628211ull;
+
+	for (; *name; name++) {
+		hash = (hash ^ (unsigned char)*name) * 1099511628211ull;
+	}
+
+	/* 0 marks a free slot */
+	return hash ? hash : 1;
+}
+
+/*
+ * Maps a table of the given capacity from fd. A new table is sized and its
+ * header written first; an existing one must match what it claims to be.
+ */
+Bool
+history_map(int fd, uint32_t capacity, Bool init)
+{
+	history_header_t *header;
+	size_t size;
+
+	/* truncating to zero first drops whatever a rejected file held */
+	size = sizeof(history_header_t) + capacity * sizeof(history_record_t);
+	if (init && ((ftruncate(fd, 0) == -1) || (ftruncate(fd, size) == -1))) {
+		return False;
+	}
+
+	header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (header == MAP_FAILED) {
+		return False;
+	}
+
+	if (init) {
+		header->magic = HISTORY_MAGIC;
+		header->version = HISTORY_VERSION;
+		header->capacity = capacity;
+	} else if ((header->magic != HISTORY_MAGIC) ||
+			(header->version != HISTORY_VERSION) ||
+			(header->capacity != capacity)) {
+		munmap(header, size);
+		return False;
+	}
+
+	history = header;
+	history_records = (history_record_t *)(header + 1);
+
+	return True;
+}
+
+/* Maps the history file on first use, starting a new one if it is unusable. */
+Bool
+history_open(void)
+{
+	char path[PATH_MAX];
+	history_header_t header;
+	struct stat sb;
+	uint32_t i;
+	int fd;
+
+	if (history || history_tried) {
+		return history != NULL;
+	}
+
+	history_tried = True;
+
+	if (!history_path(path, sizeof(path))) {
+		return False;
+	}
+
+	*strrchr(path, '/') = '\0';
+	xmkdir(path);
+	path[strlen(path)] = '/';
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		return False;
+	}
+
+	if ((fstat(fd, &sb) == 0) &&
+			(pread(fd, &header, sizeof(history_header_t), 0) == sizeof(history_header_t)) &&
+			(header.capacity > 0) &&
+			!(header.capacity & (header.capacity - 1)) &&
+			(sb.st_size == (off_t)(sizeof(history_header_t) + header.capacity * sizeof(history_record_t))) &&
+			history_map(fd, header.capacity, False)) {
+		/* damaged slots still take up probe positions until history_grow() drops them */
+		history_count = 0;
+		for (i = 0; i < history->capacity; i++) {
+			if (history_records[i].hash != 0) {
+				history_count++;
+			}
+		}
+	} else if (!history_map(fd, HISTORY_INITIAL_CAPACITY, True)) {
+		close(fd);
+		return False;
+	}
+
+	history_fd = fd;
+
+	return True;
+}
+
+Bool
+history_path(char *buffer, size_t size)
+{
+	char *base, *home;
+	int length;
+
+	base = getenv("XDG_STATE_HOME");
+	if (base && *base) {
+		length = snprintf(buffer, size, "%s/magnetwm/history", base);
+	} else {
+		home = getenv("HOME");
+		if (!home) {
+			return False;
+		}
+
+		length = snprintf(buffer, size, "%s/.local/state/magnetwm/history", home);
+	}
+
+	return (length > 0) && ((size_t)length < size);
+}
+
+void
+history_unmap(void)
+{
+	if (history) {
+		munmap(history, sizeof(history_header_t) + history->capacity * sizeof(history_record_t));
+		history = NULL;
+		history_records = NULL;
+	}
+
+	if (history_fd != -1) {
+		close(history_fd);
+		history_fd = -1;
+	}
+
+	history_count = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <stdint.h>
+
+/*
+ * Launch history for ordering menus by frecency. The history file is a
+ * memory-mapped, open-addressed table of fixed-size records keyed by a hash of
+ * the menu's namespace and the entry, so recording a launch rewrites a single
+ * record in place.
+ *
+ * Scores decay with a fixed half-life and are stored as
+ * log2(score) + time / half-life, which orders records the same way at any
+ * later time; a larger rank is better and 0 means never launched.
+ */
+
+#define HISTORY_MAGIC 0x4d574849
+#define HISTORY_VERSION 1
+#define HISTORY_HALF_LIFE (7 * 24 * 60 * 60)
+
+typedef struct history_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t reserved;
+} history_header_t;
+
+typedef struct history_record_t {
+	uint64_t hash;
+	double rank;
+	int64_t time;
+	uint32_t count;
+	/* covers the other fields, so a torn write reads as a foreign record */
+	uint32_t check;
+} history_record_t;
+
+void history_free(void);
+double history_rank(const char *, const char *);
+double history_record(const char *, const char *);
+
+#endif /* __HISTORY_H__ */
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#define INTERN_INITIAL_SIZE 64
+
+uint32_t intern_hash(const char *);
+void intern_resize(size_t);
+
+intern_t **interns = NULL;
+size_t intern_count = 0;
+size_t intern_size = 0;
+
+char *
+intern(const char *string)
+{
+	intern_t *entry;
+	size_t length;
+	uint32_t hash;
+
+	hash = intern_hash(string);
+
+	if (interns) {
+		for (entry = interns[hash & (intern_size - 1)]; entry; entry = entry->next) {
+			if (entry->hash == hash && !strcmp(entry->string, string)) {
+				entry->references++;
+				return entry->string;
+			}
+		}
+	}
+
+	if (intern_count >= intern_size * 3 / 4) {
+		intern_resize(intern_size ? intern_size * 2 : INTERN_INITIAL_SIZE);
+	}
+
+	length = strlen(string);
+	entry = malloc(sizeof(intern_t) + length + 1);
+	entry->hash = hash;
+	entry->references = 1;
+	memcpy(entry->string, string, length + 1);
+
+	entry->next = interns[hash & (intern_size - 1)];
+	interns[hash & (intern_size - 1)] = entry;
+	intern_count++;
+
+	return entry->string;
+}
+
+/* FNV-1a */
+uint32_t
+intern_hash(const char *string)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*string) {
+		hash ^= (unsigned char)*string++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+void
+intern_release(char *string)
+{
+	intern_t *entry, **link;
+
+	if (!string) {
+		return;
+	}
+
+	entry = (intern_t *)(string - offsetof(intern_t, string));
+	if (--entry->references > 0) {
+		return;
+	}
+
+	for (link = &interns[entry->hash & (intern_size - 1)]; *link; link = &(*link)->next) {
+		if (*link == entry) {
+			*link = entry->next;
+			break;
+		}
+	}
+
+	intern_count--;
+	free(entry);
+}
+
+void
+intern_resize(size_t size)
+{
+	intern_t *entry, *next, **table;
+	size_t i;
+
+	table = calloc(size, sizeof(intern_t *));
+
+	for (i = 0; i < intern_size; i++) {
+		for (entry = interns[i]; entry; entry = next) {
+			next = entry->next;
+			entry->next = table[entry->hash & (size - 1)];
+			table[entry->hash & (size - 1)] = entry;
+		}
+	}
+
+	free(interns);
+	interns = table;
+	intern_size = size;
+}
+
+char *
+intern_retain(char *string)
+{
+	intern_t *entry;
+
+	if (string) {
+		entry = (intern_t *)(string - offsetof(intern_t, string));
+		entry->references++;
+	}
+
+	return string;
+}
@@ -0,0 +1,26 @@
+#ifndef __INTERN_H__
+#define __INTERN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Interned strings. Equal strings share one reference-counted copy, so once
+ * interned they can be compared by pointer. Interned strings must not be
+ * modified and are released with intern_release().
+ */
+
+typedef struct intern_t {
+	struct intern_t *next;
+	uint32_t hash;
+	unsigned long references;
+	char string[];
+} intern_t;
+
+#define INTERN_HASH_POINTER(p, size) ((((uintptr_t)(p)) >> 4) & ((size) - 1))
+
+char *intern(const char *);
+char *intern_retain(char *);
+void intern_release(char *);
+
+#endif /* __INTERN_H__ */
@@ -7,9 +7,12 @@
 #include <string.h>
 #include <sys/signal.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "animation.h"
 #include "event.h"
+#include "exec.h"
 #include "state.h"
 #include "utils.h"
 
@@ -17,6 +20,7 @@
 #define RUNNING 1
 #define RESTART 2
 #define QUIT 3
+#define RELOAD 4
 
 volatile sig_atomic_t wm_state = IDLE;
 
@@ -31,7 +35,9 @@ signal_handler(int signum)
             while ((pid = waitpid(-1, &status, WNOHANG)) > 0 || (pid < 0 && errno == EINTR));
             break;
         case SIGHUP:
-            status = RESTART;
+            if (wm_state == RUNNING) {
+                wm_state = RELOAD;
+            }
             break;
         case SIGINT:
         case SIGTERM:
@@ -45,21 +51,28 @@ main(int argc, char **argv)
 {
 	char buf[BUFSIZ];
 	fd_set descriptors;
-	int bytes;
+	int bytes, descriptor, result;
     state_t *state;
 	struct passwd *pw;
+	struct timeval timeout;
 
 	if (!setlocale(LC_CTYPE, "") || !XSupportsLocale()) {
 		fprintf(stderr, "No locale support");
 	}
 
+	setlocale(LC_COLLATE, "");
+
 	mbtowc(NULL, NULL, MB_CUR_MAX);
 
+	srand(time(NULL));
+
     state = state_init(NULL);
     if (!state) {
         return EXIT_FAILURE;
 	}
 
+	exec_start();
+
     if ((signal(SIGCHLD, signal_handler) == SIG_ERR) ||
         (signal(SIGHUP, signal_handler) == SIG_ERR) ||
         (signal(SIGINT, signal_handler) == SIG_ERR) ||
@@ -69,21 +82,45 @@ main(int argc, char **argv)
 
     wm_state = RUNNING;
 
-    while (wm_state == RUNNING) {
+    while ((wm_state == RUNNING) || (wm_state == RELOAD)) {
+		if (wm_state == RELOAD) {
+			wm_state = RUNNING;
+			state_reload(state);
+		}
+
 		state_flush(state);
 
 		FD_ZERO(&descriptors);
 		FD_SET(state->fd, &descriptors);
+		descriptor = state->fd;
 
-		if (select(state->fd + 1, &descriptors, NULL, NULL, NULL) <= 0) {
-			continue;
+		if (state->watch != -1) {
+			FD_SET(state->watch, &descriptors);
+			descriptor = MAX(descriptor, state->watch);
 		}
 
-		if (FD_ISSET(state->fd, &descriptors)) {
+		result = select(
+				descriptor + 1,
+				&descriptors,
+				NULL,
+				NULL,
+				animation_timeout(state, &timeout) ? &timeout : NULL);
+
+		if ((result > 0) && FD_ISSET(state->fd, &descriptors)) {
 			event_process(state);
 		}
+
+		if ((result > 0) && (state->watch != -1) && FD_ISSET(state->watch, &descriptors)) {
+			state_process_watch(state);
+		}
+
+		animation_tick(state);
     }
 
+    if (wm_state == RESTART) {
+		state_save(state);
+	}
+
     state_free(state);
 
     if (wm_state == RESTART) {
@@ -0,0 +1,572 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define MATCH_X86 1
+#include <immintrin.h>
+#endif
+
+#include "match.h"
+#include "utils.h"
+
+#define MATCH_FOUND 1
+#define MATCH_MISSING 0
+#define MATCH_NOT_ASCII -1
+
+#define MATCH_LOWER(c) ((((c) >= 'A') && ((c) <= 'Z')) ? (c) | 0x20 : (c))
+
+#define MATCH_WIDE_STACK 256
+
+#define MATCH_SCORE 16
+#define MATCH_GAP_START -3
+#define MATCH_GAP_EXTENSION -1
+#define MATCH_BONUS_BOUNDARY 8
+#define MATCH_BONUS_CONSECUTIVE 4
+#define MATCH_BONUS_PREFIX 12
+
+int match_ascii(match_token_t *, const char *, size_t);
+#ifdef MATCH_X86
+int match_ascii_avx2(match_token_t *, const char *, size_t, size_t *);
+int match_ascii_sse2(match_token_t *, const char *, size_t, size_t *);
+#endif
+Bool match_boundary(wchar_t);
+wchar_t match_decode(const unsigned char **);
+size_t match_fold(const char *, wchar_t *);
+int match_score_window(match_token_t *, wchar_t *, size_t);
+uint64_t match_signature_bit(wchar_t);
+Bool match_subsequence(match_token_t *, const char *);
+void match_token_init(match_token_t *, const char *, size_t);
+Bool match_verify(match_token_t *, const char *);
+Bool match_wide(match_token_t *, const char *, size_t);
+
+Bool
+match_find(match_t *match, const char *text)
+{
+	match_token_t *token;
+	size_t length;
+	int i, result = MATCH_MISSING;
+
+	length = strlen(text);
+
+	for (i = 0; i < match->count; i++) {
+		token = &match->tokens[i];
+
+		if (token->ascii && (result != MATCH_NOT_ASCII)) {
+			result = match_ascii(token, text, length);
+			if (result == MATCH_FOUND) {
+				continue;
+			} else if (result == MATCH_MISSING) {
+				return False;
+			}
+		}
+
+		if (!match_wide(token, text, length)) {
+			return False;
+		}
+	}
+
+	return True;
+}
+
+void
+match_free(match_t *match)
+{
+	int i;
+
+	for (i = 0; i < match->count; i++) {
+		free(match->tokens[i].needle);
+		free(match->tokens[i].wide);
+	}
+
+	free(match->tokens);
+	memset(match, 0, sizeof(match_t));
+}
+
+/* Splits the query into its space separated tokens, all of which must match. */
+void
+match_init(match_t *match, const char *query)
+{
+	const char *p, *start;
+
+	match->count = 0;
+	match->tokens = malloc((strlen(query) / 2 + 1) * sizeof(match_token_t));
+	match->signature = match_signature(query);
+
+	for (p = query; *p; ) {
+		while (*p == ' ') {
+			p++;
+		}
+
+		for (start = p; *p && (*p != ' '); p++);
+
+		if (p > start) {
+			match_token_init(&match->tokens[match->count++], start, p - start);
+		}
+	}
+}
+
+/*
+ * Returns how well every token matches the text as a subsequence, or -1 if
+ * one of them does not.
+ */
+int
+match_score(match_t *match, const char *text)
+{
+	wchar_t stack[MATCH_WIDE_STACK], *wide = stack;
+	size_t count, length;
+	int i, score = 0, token_score;
+
+	if (match->count == 0) {
+		return 0;
+	}
+
+	/* Most texts miss a character; reject those without decoding them. */
+	for (i = 0; i < match->count; i++) {
+		if (match->tokens[i].ascii && !match_subsequence(&match->tokens[i], text)) {
+			return -1;
+		}
+	}
+
+	length = strlen(text);
+	if (length > MATCH_WIDE_STACK) {
+		wide = malloc(length * sizeof(wchar_t));
+	}
+
+	count = match_fold(text, wide);
+	for (i = 0; i < match->count; i++) {
+		token_score = match_score_window(&match->tokens[i], wide, count);
+		if (token_score < 0) {
+			score = -1;
+			break;
+		}
+
+		score += token_score;
+	}
+
+	if (wide != stack) {
+		free(wide);
+	}
+
+	return score;
+}
+
+/*
+ * Returns which characters occur in the text, folded, as one bit per letter
+ * or digit and a few bits shared by the rest. A text can only match a query
+ * whose signature bits it all has.
+ */
+uint64_t
+match_signature(const char *text)
+{
+	const unsigned char *s = (const unsigned char *)text;
+	uint64_t signature = 0;
+
+	while (*s) {
+		if (*s < 0x80) {
+			signature |= match_signature_bit(MATCH_LOWER(*s));
+			s++;
+		} else {
+			signature |= match_signature_bit(towlower(match_decode(&s)));
+		}
+	}
+
+	return signature;
+}
+
+/*
+ * Looks for the ASCII needle in the text, returning MATCH_NOT_ASCII as soon
+ * as the text turns out not to be ASCII, since it then needs Unicode folding.
+ */
+int
+match_ascii(match_token_t *token, const char *text, size_t length)
+{
+	size_t i = 0, j;
+#ifdef MATCH_X86
+	static int avx2 = -1;
+	int result;
+#endif
+
+	if (length < token->length) {
+		for (j = 0; j < length; j++) {
+			if ((unsigned char)text[j] & 0x80) {
+				return MATCH_NOT_ASCII;
+			}
+		}
+
+		return MATCH_MISSING;
+	}
+
+#ifdef MATCH_X86
+	if (avx2 == -1) {
+		__builtin_cpu_init();
+		avx2 = __builtin_cpu_supports("avx2");
+	}
+
+	if (avx2) {
+		result = match_ascii_avx2(token, text, length, &i);
+	} else {
+		result = match_ascii_sse2(token, text, length, &i);
+	}
+
+	if (result != MATCH_MISSING) {
+		return result;
+	}
+#endif
+
+	for (j = i; j < length; j++) {
+		if ((unsigned char)text[j] & 0x80) {
+			return MATCH_NOT_ASCII;
+		}
+	}
+
+	for (; i + token->length <= length; i++) {
+		if (match_verify(token, text + i)) {
+			return MATCH_FOUND;
+		}
+	}
+
+	return MATCH_MISSING;
+}
+
+#ifdef MATCH_X86
+/*
+ * Compares 32 candidate positions at once against the needle's first and
+ * last bytes and only verifies the positions where both agree. Scanning
+ * stops where a full block no longer fits; *position is where it left off.
+ */
+__attribute__((target("avx2")))
+int
+match_ascii_avx2(match_token_t *token, const char *text, size_t length, size_t *position)
+{
+	size_t i;
+	uint32_t mask;
+	__m256i block_first, block_last, lower, upper;
+	__m256i first = _mm256_set1_epi8(token->needle[0]);
+	__m256i last = _mm256_set1_epi8(token->needle[token->length - 1]);
+	__m256i offset = _mm256_set1_epi8(128 - 'A');
+	__m256i limit = _mm256_set1_epi8(-128 + 26);
+	__m256i bit = _mm256_set1_epi8(0x20);
+
+	for (i = *position; i + 32 + token->length - 1 <= length; i += 32) {
+		block_first = _mm256_loadu_si256((const __m256i *)(text + i));
+		block_last = _mm256_loadu_si256((const __m256i *)(text + i + token->length - 1));
+		if (_mm256_movemask_epi8(block_first)) {
+			return MATCH_NOT_ASCII;
+		}
+
+		upper = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(block_first, offset));
+		lower = _mm256_or_si256(block_first, _mm256_and_si256(upper, bit));
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lower, first));
+
+		upper = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(block_last, offset));
+		lower = _mm256_or_si256(block_last, _mm256_and_si256(upper, bit));
+		mask &= _mm256_movemask_epi8(_mm256_cmpeq_epi8(lower, last));
+
+		while (mask) {
+			if (match_verify(token, text + i + __builtin_ctz(mask))) {
+				return MATCH_FOUND;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	*position = i;
+
+	return MATCH_MISSING;
+}
+
+/* The 16 byte variant of match_ascii_avx2(), for CPUs without AVX2. */
+int
+match_ascii_sse2(match_token_t *token, const char *text, size_t length, size_t *position)
+{
+	size_t i;
+	uint32_t mask;
+	__m128i block_first, block_last, lower, upper;
+	__m128i first = _mm_set1_epi8(token->needle[0]);
+	__m128i last = _mm_set1_epi8(token->needle[token->length - 1]);
+	__m128i offset = _mm_set1_epi8(128 - 'A');
+	__m128i limit = _mm_set1_epi8(-128 + 26);
+	__m128i bit = _mm_set1_epi8(0x20);
+
+	for (i = *position; i + 16 + token->length - 1 <= length; i += 16) {
+		block_first = _mm_loadu_si128((const __m128i *)(text + i));
+		block_last = _mm_loadu_si128((const __m128i *)(text + i + token->length - 1));
+		if (_mm_movemask_epi8(block_first)) {
+			return MATCH_NOT_ASCII;
+		}
+
+		upper = _mm_cmplt_epi8(_mm_add_epi8(block_first, offset), limit);
+		lower = _mm_or_si128(block_first, _mm_and_si128(upper, bit));
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(lower, first));
+
+		upper = _mm_cmplt_epi8(_mm_add_epi8(block_last, offset), limit);
+		lower = _mm_or_si128(block_last, _mm_and_si128(upper, bit));
+		mask &= _mm_movemask_epi8(_mm_cmpeq_epi8(lower, last));
+
+		while (mask) {
+			if (match_verify(token, text + i + __builtin_ctz(mask))) {
+				return MATCH_FOUND;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	*position = i;
+
+	return MATCH_MISSING;
+}
+#endif
+
+/* Whether a match right after this character starts a new word. */
+Bool
+match_boundary(wchar_t c)
+{
+	if (c < 0x80) {
+		return !((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'));
+	}
+
+	return !iswalnum(c);
+}
+
+/*
+ * Decodes one UTF-8 sequence and advances past it. Malformed bytes decode to
+ * themselves, as Latin-1, one at a time.
+ */
+wchar_t
+match_decode(const unsigned char **s)
+{
+	const unsigned char *p = *s;
+	wchar_t c;
+	int i, n;
+
+	if (p[0] < 0x80) {
+		*s = p + 1;
+		return p[0];
+	}
+
+	if ((p[0] & 0xe0) == 0xc0) {
+		c = p[0] & 0x1f;
+		n = 1;
+	} else if ((p[0] & 0xf0) == 0xe0) {
+		c = p[0] & 0x0f;
+		n = 2;
+	} else if ((p[0] & 0xf8) == 0xf0) {
+		c = p[0] & 0x07;
+		n = 3;
+	} else {
+		*s = p + 1;
+		return p[0];
+	}
+
+	for (i = 1; i <= n; i++) {
+		if ((p[i] & 0xc0) != 0x80) {
+			*s = p + 1;
+			return p[0];
+		}
+
+		c = (c << 6) | (p[i] & 0x3f);
+	}
+
+	*s = p + n + 1;
+
+	return c;
+}
+
+/* Decodes and folds the text into buffer, returning its length. */
+size_t
+match_fold(const char *text, wchar_t *buffer)
+{
+	const unsigned char *s = (const unsigned char *)text;
+	size_t count = 0;
+
+	while (*s) {
+		if (*s < 0x80) {
+			buffer[count++] = MATCH_LOWER(*s);
+			s++;
+		} else {
+			buffer[count++] = towlower(match_decode(&s));
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Scores the folded text like fzf's first algorithm: the first occurrence of
+ * the needle's last character ends the match, which is then shrunk from the
+ * right, so the window scored is short but not necessarily the best one.
+ */
+int
+match_score_window(match_token_t *token, wchar_t *wide, size_t count)
+{
+	size_t i, j, start, end;
+	int bonus, run = 0, score = 0;
+	Bool gap = False, previous = False;
+
+	for (i = 0, j = 0; i < count; i++) {
+		if ((wide[i] == token->wide[j]) && (++j == token->wide_length)) {
+			break;
+		}
+	}
+
+	if (j < token->wide_length) {
+		return -1;
+	}
+
+	end = i;
+	for (j = token->wide_length; ; i--) {
+		if ((wide[i] == token->wide[j - 1]) && (--j == 0)) {
+			break;
+		}
+	}
+
+	start = i;
+	for (i = start, j = 0; i <= end; i++) {
+		if (wide[i] != token->wide[j]) {
+			score += gap ? MATCH_GAP_EXTENSION : MATCH_GAP_START;
+			gap = True;
+			previous = False;
+			continue;
+		}
+
+		if (i == 0) {
+			bonus = MATCH_BONUS_PREFIX;
+		} else if (match_boundary(wide[i - 1])) {
+			bonus = MATCH_BONUS_BOUNDARY;
+		} else {
+			bonus = 0;
+		}
+
+		/* A run keeps the bonus of the boundary it started at. */
+		if (previous) {
+			bonus = MAX(MAX(bonus, run), MATCH_BONUS_CONSECUTIVE);
+		} else {
+			run = bonus;
+		}
+
+		if (j == 0) {
+			bonus *= 2;
+		}
+
+		score += MATCH_SCORE + bonus;
+		gap = False;
+		previous = True;
+		j++;
+	}
+
+	return score;
+}
+
+uint64_t
+match_signature_bit(wchar_t c)
+{
+	if (c == ' ') {
+		return 0;
+	} else if ((c >= 'a') && (c <= 'z')) {
+		return 1ull << (c - 'a');
+	} else if ((c >= '0') && (c <= '9')) {
+		return 1ull << (26 + c - '0');
+	} else if (c < 0x80) {
+		return 1ull << (36 + c % 27);
+	}
+
+	return 1ull << 63;
+}
+
+/*
+ * Whether the ASCII token occurs in the text as a subsequence. Text that is
+ * not ASCII is let through, as it needs Unicode folding to tell.
+ */
+Bool
+match_subsequence(match_token_t *token, const char *text)
+{
+	const unsigned char *s;
+	size_t j = 0;
+
+	for (s = (const unsigned char *)text; *s && (*s < 0x80); s++) {
+		if ((MATCH_LOWER(*s) == token->needle[j]) && (++j == token->length)) {
+			return True;
+		}
+	}
+
+	return *s != '\0';
+}
+
+void
+match_token_init(match_token_t *token, const char *needle, size_t length)
+{
+	size_t i;
+	const unsigned char *s, *end;
+
+	token->length = length;
+	token->needle = malloc(length + 1);
+	token->ascii = True;
+	for (i = 0; i < length; i++) {
+		token->needle[i] = MATCH_LOWER(needle[i]);
+		if ((unsigned char)needle[i] & 0x80) {
+			token->ascii = False;
+		}
+	}
+
+	token->needle[length] = '\0';
+
+	token->wide = malloc((length + 1) * sizeof(wchar_t));
+	token->wide_length = 0;
+	s = (const unsigned char *)token->needle;
+	end = s + length;
+	while (s < end) {
+		token->wide[token->wide_length++] = towlower(match_decode(&s));
+	}
+}
+
+Bool
+match_verify(match_token_t *token, const char *text)
+{
+	size_t i;
+
+	for (i = 0; i < token->length; i++) {
+		if (MATCH_LOWER(text[i]) != token->needle[i]) {
+			return False;
+		}
+	}
+
+	return True;
+}
+
+/*
+ * Folds the text with towlower(), which for a UTF-8 locale is the simple
+ * case folding the needle went through, and searches it for the needle.
+ */
+Bool
+match_wide(match_token_t *token, const char *text, size_t length)
+{
+	wchar_t stack[MATCH_WIDE_STACK], *wide = stack;
+	size_t count, i, j;
+	Bool found = False;
+
+	if (length > MATCH_WIDE_STACK) {
+		wide = malloc(length * sizeof(wchar_t));
+	}
+
+	count = match_fold(text, wide);
+
+	for (i = 0; !found && (i + token->wide_length <= count); i++) {
+		for (j = 0; j < token->wide_length; j++) {
+			if (wide[i + j] != token->wide[j]) {
+				break;
+			}
+		}
+
+		found = j == token->wide_length;
+	}
+
+	if (wide != stack) {
+		free(wide);
+	}
+
+	return found;
+}
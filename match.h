@@ -0,0 +1,41 @@
+#ifndef __MATCH_H__
+#define __MATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#include <X11/Xlib.h>
+
+/*
+ * Case-insensitive substring matching for menu filters. The needle is folded
+ * once by match_init(); ASCII haystacks are scanned a vector at a time, other
+ * UTF-8 text is decoded and folded code point by code point. A query holds
+ * space separated tokens, all of which have to match.
+ *
+ * match_score() instead treats the needle as a subsequence and rates how well
+ * it fits, favouring consecutive runs and matches at word boundaries.
+ */
+
+typedef struct match_token_t {
+	char *needle;
+	size_t length;
+	Bool ascii;
+
+	wchar_t *wide;
+	size_t wide_length;
+} match_token_t;
+
+typedef struct match_t {
+	match_token_t *tokens;
+	int count;
+	uint64_t signature;
+} match_t;
+
+Bool match_find(match_t *, const char *);
+void match_free(match_t *);
+void match_init(match_t *, const char *);
+int match_score(match_t *, const char *);
+uint64_t match_signature(const char *);
+
+#endif /* __MATCH_H__ */
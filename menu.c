@@ -6,7 +6,11 @@
 #include <X11/XKBlib.h>
 #include <X11/Xlib.h>
 
+#include "arena.h"
 #include "config.h"
+#include "glyph.h"
+#include "history.h"
+#include "match.h"
 #include "menu.h"
 #include "screen.h"
 #include "state.h"
@@ -28,69 +32,119 @@
 		ButtonMotionMask	|	\
 		StructureNotifyMask)
 
+/* Lower scores rank worse; of equal scores, the one listed later does. */
+#define MENU_RANK_WORSE(a, b) (((a).score < (b).score) || (((a).score == (b).score) && ((a).position > (b).position)))
+
+void menu_attach(menu_t *);
 int menu_calculate_entry(menu_t *, int, int);
+int menu_compare_bytes(const void *, const void *);
+int menu_compare_locale(const void *, const void *);
+void menu_damage(menu_t *, int);
 void menu_draw(menu_t *);
-void menu_draw_selection(menu_t *, int);
 int menu_filter_add(menu_t *, char *);
+void menu_filter_apply(menu_t *);
 int menu_filter_complete(menu_t *);
-int menu_filter_delete(menu_t *);
+int menu_filter_delete(menu_t *, int);
+void menu_filter_reserve(menu_t *, size_t);
 void menu_filter_update(menu_t *);
+void menu_glyphs_add(menu_t *, XftFont *, int, int, const char *);
+void menu_glyphs_flush(menu_t *, color_t);
 int menu_handle_key(menu_t *, XKeyEvent *);
 Bool menu_handle_move(menu_t *, int, int);
 int menu_handle_release(menu_t *, int, int);
+void menu_item_measure(menu_t *, menu_item_t *);
 int menu_move_down(menu_t *);
 int menu_move_left(menu_t *);
 int menu_move_right(menu_t *);
 int menu_move_up(menu_t *);
-
-void
+Bool menu_next_key(menu_t *, XEvent *);
+void menu_paint_frame(menu_t *);
+void menu_paint_items(menu_t *, int, int);
+void menu_paint_row(menu_t *, int, XRectangle *);
+void menu_place(menu_t *);
+void menu_redraw(menu_t *, int, int);
+void menu_render(menu_t *);
+void menu_reset(menu_t *);
+menu_item_t *menu_result(menu_t *, int);
+void menu_results_build(menu_t *);
+void menu_results_narrow(menu_t *);
+menu_results_t *menu_results_push(menu_t *);
+void menu_results_rank(menu_t *, menu_results_t *, int);
+void menu_results_select(menu_t *);
+void menu_results_sift(menu_rank_t *, int);
+
+#ifdef MENU_STATS
+/* Redraws saved by applying queued keys in one batch. */
+unsigned long menu_redraws_avoided = 0;
+#endif /* MENU_STATS */
+
+menu_item_t *
 menu_add(menu_t *menu, void *context, Bool sorted, char *text, char *detail)
 {
-	int cmp;
-	menu_item_t *current, *item;
-	XGlyphInfo extents;
-
-	XftTextExtentsUtf8(
-			menu->state->display,
-			menu->state->fonts[FONT_MENU_ITEM],
-			(const FcChar8 *)text,
-			strlen(text),
-			&extents);
+	menu_item_t *item;
 
-	item = malloc(sizeof(menu_item_t));
+	item = arena_alloc(&menu->arena, sizeof(menu_item_t));
 	item->context = context;
-	item->text = strdup(text);
-	item->text_width = extents.width;
-
+	item->text = arena_strdup(&menu->arena, text);
+	item->signature = match_signature(item->text);
 	if (detail) {
-		XftTextExtentsUtf8(
-				menu->state->display,
-				menu->state->fonts[FONT_MENU_ITEM_DETAIL],
-				(const FcChar8 *)detail,
-				strlen(detail),
-				&extents);
-		item->detail = strdup(detail);
-		item->detail_width = extents.width;
-	} else {
-		item->detail = NULL;
-		item->detail_width = 0;
+		item->detail = arena_strdup(&menu->arena, detail);
 	}
 
-	if (sorted) {
-		TAILQ_FOREACH(current, &menu->items, item) {
-			cmp = strcmp(item->text, current->text);
-			if (cmp == 0) {
-				return;
-			}
+	if (menu->history) {
+		item->rank = history_rank(menu->history, item->text);
+	}
 
-			if (cmp < 0) {
-				TAILQ_INSERT_BEFORE(current, item, item);
-				return;
-			}
+	if (sorted) {
+		if (menu->pending_count == menu->pending_size) {
+			menu->pending_size = menu->pending_size ? menu->pending_size * 2 : 256;
+			menu->pending = realloc(menu->pending, menu->pending_size * sizeof(menu_item_t *));
 		}
+
+		item->order = menu->pending_count;
+		menu->pending[menu->pending_count++] = item;
+
+		return item;
 	}
 
+	menu_item_measure(menu, item);
 	TAILQ_INSERT_TAIL(&menu->items, item, item);
+
+	return item;
+}
+
+/*
+ * Menus share one window per screen, created on first use and only unmapped
+ * when a menu closes; screen_free() destroys it.
+ */
+void
+menu_attach(menu_t *menu)
+{
+	screen_t *screen = menu->screen;
+	state_t *state = menu->state;
+
+	if (screen->menu_window == None) {
+		screen->menu_window = XCreateSimpleWindow(
+				state->display,
+				state->root,
+				0,
+				0,
+				1,
+				1,
+				state->config->border_width,
+				state->colors[COLOR_BORDER_ACTIVE].pixel,
+				state->colors[COLOR_MENU_BACKGROUND].pixel);
+		/* every pixel comes from the pixmap, so the server need not clear */
+		XSetWindowBackgroundPixmap(state->display, screen->menu_window, None);
+		screen->menu_gc = XCreateGC(state->display, screen->menu_window, 0, NULL);
+
+		x_set_class_hint(state->display, screen->menu_window, state->config->wm_name);
+		XSelectInput(state->display, screen->menu_window, MENUMASK);
+	}
+
+	menu->window = screen->menu_window;
+	menu->gc = screen->menu_gc;
+	menu->dirty_frame = True;
 }
 
 int
@@ -114,155 +168,219 @@ menu_calculate_entry(menu_t *menu, int x, int y)
 }
 
 void
-menu_draw(menu_t *menu)
+menu_close(menu_t *menu, Bool cancelled)
 {
-	int i = 0, y;
-	menu_item_t *item;
-	XftFont *font;
+	menu_item_t *item = NULL;
+	state_t *state = menu->state;
 
-	menu->geometry.height = menu->offset + MIN(menu->limit, menu->count) * (menu->state->fonts[FONT_MENU_ITEM]->height + 1);
-	if (menu->count > 0) {
-		menu->geometry.height += 2 * menu->padding;
+	if (!cancelled && (menu->selected_visible >= 0)) {
+		item = menu_result(menu, menu->visible + menu->selected_visible);
 	}
 
-	XClearWindow(menu->state->display, menu->window);
-	XMoveResizeWindow(
-			menu->state->display,
-			menu->window,
-			menu->geometry.x,
-			menu->geometry.y,
-			menu->geometry.width,
-			menu->geometry.height);
-
-	if (menu->prompt) {
-		if (menu->filter_length == 0) {
-			XftDrawStringUtf8(
-					menu->draw,
-					&menu->state->colors[COLOR_MENU_PROMPT],
-					menu->state->fonts[FONT_MENU_INPUT],
-					menu->padding,
-					menu->padding + menu->state->fonts[FONT_MENU_INPUT]->ascent,
-					(const FcChar8 *)menu->prompt,
-					strlen(menu->prompt));
-		} else {
-			XftDrawStringUtf8(
-					menu->draw,
-					&menu->state->colors[COLOR_MENU_FOREGROUND],
-					menu->state->fonts[FONT_MENU_INPUT],
-					menu->padding,
-					menu->padding + menu->state->fonts[FONT_MENU_INPUT]->ascent,
-					(const FcChar8 *)menu->filter,
-					menu->filter_length);
-		}
+	if (item && menu->history) {
+		item->rank = history_record(menu->history, item->text);
+	}
 
-		if (menu->count > 0) {
-			XftDrawRect(
-					menu->draw,
-					&menu->state->colors[COLOR_MENU_SEPARATOR],
-					0,
-					menu->offset - 1,
-					menu->geometry.width,
-					1);
-		}
+	if (menu->window != None) {
+		XUnmapWindow(state->display, menu->window);
 	}
 
-	item = menu->visible;
-	font = menu->state->fonts[FONT_MENU_ITEM];
-	while ((i < menu->limit) && item) {
-		y = menu->offset + menu->padding + i * (font->height + 1) + font->ascent;
-		XftDrawStringUtf8(
-				menu->draw,
-				&menu->state->colors[COLOR_MENU_FOREGROUND],
-				font,
-				menu->padding,
-				y,
-				(const FcChar8 *)item->text,
-				strlen(item->text));
+	if (state->menu == menu) {
+		XSetInputFocus(state->display, menu->focus, menu->focus_revert, CurrentTime);
 
-		if (item->detail) {
-			XftDrawStringUtf8(
-					menu->draw,
-					&menu->state->colors[COLOR_MENU_FOREGROUND],
-					menu->state->fonts[FONT_MENU_ITEM_DETAIL],
-					menu->geometry.width - menu->padding - item->detail_width,
-					y,
-					(const FcChar8 *)item->detail,
-					strlen(item->detail));
-		}
+		XUngrabKeyboard(state->display, CurrentTime);
+		XUngrabPointer(state->display, CurrentTime);
+
+		state->menu = NULL;
+	}
 
-		item = TAILQ_NEXT(item, result);
-		i++;
+	if (menu->select) {
+		menu->select(state, menu, item ? item->context : NULL);
 	}
 
-	if (i > 0) {
-		menu_draw_selection(menu, menu->selected_visible);
+	if (menu->persistent) {
+		menu_reset(menu);
+	} else {
+		menu_free(menu);
 	}
 }
 
-void
-menu_draw_selection(menu_t *menu, int entry)
+int
+menu_compare_bytes(const void *a, const void *b)
 {
-	int i;
-	menu_item_t *item = menu->visible;
-	XftFont *font;
+	int cmp;
+	const menu_item_t *x = *(menu_item_t * const *)a, *y = *(menu_item_t * const *)b;
 
-	for (i = 0; i < entry; i++) {
-		item = TAILQ_NEXT(item, result);
+	cmp = strcmp(x->text, y->text);
+	if (cmp != 0) {
+		return cmp;
 	}
 
-	if (!item) {
+	return (x->order > y->order) - (x->order < y->order);
+}
+
+int
+menu_compare_locale(const void *a, const void *b)
+{
+	int cmp;
+	const menu_item_t *x = *(menu_item_t * const *)a, *y = *(menu_item_t * const *)b;
+
+	cmp = strcoll(x->text, y->text);
+	if (cmp != 0) {
+		return cmp;
+	}
+
+	return (x->order > y->order) - (x->order < y->order);
+}
+
+/* Marks a row of the visible window for repainting by menu_render(). */
+void
+menu_damage(menu_t *menu, int row)
+{
+	if ((row < 0) || (row >= menu->limit)) {
 		return;
 	}
 
-	font = menu->state->fonts[FONT_MENU_ITEM];
+	if (row >= 64) {
+		menu->dirty_frame = True;
+	} else {
+		menu->dirty_rows |= 1ull << row;
+	}
+}
 
-	XftDrawRect(
-			menu->draw,
-			&menu->state->colors[COLOR_MENU_SELECTION_BACKGROUND],
-			0,
-			menu->offset + menu->padding + entry * (font->height + 1) + 1,
-			menu->geometry.width,
-			font->height + 1);
+/* Repaints the whole menu. */
+void
+menu_draw(menu_t *menu)
+{
+	menu->dirty_frame = True;
+	menu_render(menu);
+}
 
-	XftDrawStringUtf8(
-			menu->draw,
-			&menu->state->colors[COLOR_MENU_SELECTION_FOREGROUND],
-			font,
-			menu->padding,
-			menu->offset + menu->padding + entry * (font->height + 1) + font->ascent,
-			(const FcChar8 *)item->text,
-			strlen(item->text));
+#ifdef MENU_STATS
+void
+menu_dump(FILE *stream)
+{
+	fprintf(stream, "menu: %lu redraws avoided\n", menu_redraws_avoided);
+}
+#endif /* MENU_STATS */
 
-	if (item->detail) {
-		XftDrawStringUtf8(
-				menu->draw,
-				&menu->state->colors[COLOR_MENU_FOREGROUND],
-				menu->state->fonts[FONT_MENU_ITEM_DETAIL],
-				menu->geometry.width - menu->padding - item->detail_width,
-				menu->offset + menu->padding + entry * (font->height + 1) + font->ascent,
-				(const FcChar8 *)item->detail,
-				strlen(item->detail));
+Bool
+menu_handle_event(menu_t *menu, XEvent *event)
+{
+	int result, selected, visible;
+	Bool redraw;
+	XEvent next;
+
+	if (event->xany.window != menu->window) {
+		return False;
 	}
 
-	if (menu->callback) {
-		menu->callback(menu->state, item->context);
+	selected = menu->selected_visible;
+	visible = menu->visible;
+
+	switch (event->type) {
+		case KeyPress:
+			/*
+			 * Keys that queued up while the last batch was filtered and
+			 * drawn, e.g. from fast typing or auto-repeat, are applied
+			 * together and cost a single filter pass and redraw.
+			 */
+			result = menu_handle_key(menu, &event->xkey);
+			redraw = (result == 1);
+			while ((result >= 0) && (result <= 1) && menu_next_key(menu, &next)) {
+				result = menu_handle_key(menu, &next.xkey);
+				if (result == 1) {
+#ifdef MENU_STATS
+					if (redraw) {
+						menu_redraws_avoided++;
+					}
+#endif /* MENU_STATS */
+					redraw = True;
+				}
+			}
+
+			menu_filter_apply(menu);
+
+			if (result == -1) {
+				menu_close(menu, True);
+			} else if ((result == 2) && (menu->count > 0)) {
+				menu_close(menu, False);
+			} else if (redraw) {
+				menu_redraw(menu, visible, selected);
+			}
+
+			break;
+		case KeyRelease:
+			if (menu->cycle) {
+				if ((event->xkey.keycode == 0x40) && (event->xkey.state & Mod1Mask)) {
+					menu_close(menu, False);
+				}
+			}
+
+			break;
+		case MotionNotify:
+			if (menu_handle_move(menu, event->xbutton.x_root, event->xbutton.y_root)) {
+				menu_redraw(menu, visible, selected);
+			}
+
+			break;
+		case ButtonPress:
+			if (event->xbutton.button == Button4) {
+				menu_move_up(menu);
+				menu_redraw(menu, visible, selected);
+			} else if (event->xbutton.button == Button5) {
+				menu_move_down(menu);
+				menu_redraw(menu, visible, selected);
+			}
+
+			break;
+		case ButtonRelease:
+			if (event->xbutton.button == Button1) {
+				result = menu_handle_release(menu, event->xbutton.x_root, event->xbutton.y_root);
+				menu_close(menu, result == -1);
+			}
+
+			break;
+		case Expose:
+			if (menu->draw) {
+				XCopyArea(
+						menu->state->display,
+						menu->pixmap,
+						menu->window,
+						menu->gc,
+						event->xexpose.x,
+						event->xexpose.y,
+						event->xexpose.width,
+						event->xexpose.height,
+						event->xexpose.x,
+						event->xexpose.y);
+			}
+
+			break;
 	}
+
+	return True;
 }
 
-void *
-menu_filter(menu_t *menu)
+Bool
+menu_open(menu_t *menu)
 {
-	Bool processing = True;
-	int focusrevert, i, width_detail = 0, width_text = 0;
+	int width, width_detail = 0, width_text = 0;
 	menu_item_t *item;
-	Window focus;
-	XEvent event;
-	XGlyphInfo extents;
 
-	TAILQ_FOREACH(item, &menu->items, item) {
-		TAILQ_INSERT_TAIL(&menu->results, item, result);
-		menu->count++;
+	if (menu->state->menu == menu) {
+		return False;
+	}
+
+	if (menu->state->menu || (menu->state->drag.mode != DRAG_NONE)) {
+		menu_close(menu, True);
+		return False;
+	}
 
+	menu_sort(menu);
+	menu_results_build(menu);
+
+	TAILQ_FOREACH(item, &menu->items, item) {
 		if (item->text_width > width_text) {
 			width_text = item->text_width;
 		}
@@ -278,23 +396,15 @@ menu_filter(menu_t *menu)
 	}
 
 	if (menu->prompt) {
-		XftTextExtentsUtf8(
-				menu->state->display,
-				menu->state->fonts[FONT_MENU_INPUT],
-				(const FcChar8 *)menu->prompt,
-				strlen(menu->prompt),
-				&extents);
-		if (extents.width > menu->geometry.width) {
-			menu->geometry.width = extents.width;
+		width = glyph_width(menu->state->display, menu->state->fonts[FONT_MENU_INPUT], menu->prompt);
+		if (width > menu->geometry.width) {
+			menu->geometry.width = width;
 		}
 	}
 
-	if (menu->cycle) {
-		if (menu->count < 2) {
-			return NULL;
-		}
-	} else if (menu->count == 0) {
-		return NULL;
+	if ((menu->count == 0) || (menu->cycle && (menu->count < 2))) {
+		menu_close(menu, True);
+		return False;
 	}
 
 	menu->geometry.width += 2 * menu->padding;
@@ -305,13 +415,16 @@ menu_filter(menu_t *menu)
 	menu->geometry.x = menu->screen->geometry.x + (menu->screen->geometry.width - menu->geometry.width) / 2;
 	menu->geometry.y = menu->screen->geometry.y + 0.2 * menu->screen->geometry.height;
 
-	menu->visible = TAILQ_FIRST(&menu->results);
+	menu->visible = 0;
 	if (menu->cycle) {
 		menu->selected_item = 1;
 		menu->selected_visible = 1;
 	}
 
-	XSelectInput(menu->state->display, menu->window, MENUMASK);
+	XGetInputFocus(menu->state->display, &menu->focus, &menu->focus_revert);
+
+	menu_attach(menu);
+	menu_place(menu);
 	XMapRaised(menu->state->display, menu->window);
 
 	if (XGrabPointer(
@@ -324,143 +437,81 @@ menu_filter(menu_t *menu)
 				None,
 				None,
 				CurrentTime) != GrabSuccess) {
-		XftDrawDestroy(menu->draw);
-		XDestroyWindow(menu->state->display, menu->window);
-		return NULL;
+		menu_close(menu, True);
+		return False;
 	}
 
-	XGetInputFocus(menu->state->display, &focus, &focusrevert);
 	XSetInputFocus(menu->state->display, menu->window, RevertToPointerRoot, CurrentTime);
 
 	XGrabKeyboard(menu->state->display, menu->window, True, GrabModeAsync, GrabModeAsync, CurrentTime);
 
-	menu_draw(menu);
-
-	while (processing) {
-		XWindowEvent(menu->state->display, menu->window, MENUMASK, &event);
-		switch (event.type) {
-			case KeyPress:
-				i = menu_handle_key(menu, &event.xkey);
-				if (i == 1) {
-					menu_draw(menu);
-				} else if ((i == -1) || ((i == 2) && (menu->count > 0))) {
-					processing = False;
-				}
-
-				break;
-			case KeyRelease:
-				if (menu->cycle) {
-					if ((event.xkey.keycode == 0x40) && (event.xkey.state & Mod1Mask)) {
-						processing = False;
-					}
-				}
-
-				break;
-			case MotionNotify:
-				if (menu_handle_move(menu, event.xbutton.x_root, event.xbutton.y_root)) {
-					menu_draw(menu);
-				}
-				break;
-			case ButtonPress:
-				if (event.xbutton.button == Button4) {
-					menu_move_up(menu);
-					menu_draw(menu);
-				} else if (event.xbutton.button == Button5) {
-					menu_move_down(menu);
-					menu_draw(menu);
-				}
-
-				break;
-			case ButtonRelease:
-				if (event.xbutton.button == Button1) {
-					i = menu_handle_release(menu, event.xbutton.x_root, event.xbutton.y_root);
-					processing = False;
-				}
-
-				break;
-		}
-	}
-
-	XftDrawDestroy(menu->draw);
-	XDestroyWindow(menu->state->display, menu->window);
-
-	XSetInputFocus(menu->state->display, focus, focusrevert, CurrentTime);
+	menu->state->menu = menu;
 
-	XUngrabKeyboard(menu->state->display, CurrentTime);
-	XUngrabPointer(menu->state->display, CurrentTime);
-
-	if (menu->filter) {
-		free(menu->filter);
-	}
-
-	if (i == -1) {
-		return NULL;
-	}
-
-	item = menu->visible;
-	for (i = 0; i < menu->selected_visible; i++) {
-		item = TAILQ_NEXT(item, result);
-	}
+	menu_draw(menu);
 
-	return (item == NULL) ? NULL : item->context;
+	return True;
 }
 
 int
 menu_filter_add(menu_t *menu, char *suffix)
 {
 	int len;
-	menu_item_t *item, *next;
 
 	len = strlen(suffix);
-	if (menu->filter_length == 0) {
-		menu->filter = malloc(len + 1);
-	} else {
-		menu->filter = realloc(menu->filter, menu->filter_length + len + 1);
-	}
+	menu_filter_reserve(menu, menu->filter_length + len + 1);
 
 	memcpy(menu->filter + menu->filter_length, suffix, len);
 	menu->filter_length += len;
 	menu->filter[menu->filter_length] = '\0';
+	menu->filter_pending = True;
 
-	item = TAILQ_FIRST(&menu->results);
-	menu->count = 0;
-	while (item) {
-		next = TAILQ_NEXT(item, result);
+	return 1;
+}
 
-		if (strcasestr(item->text, menu->filter)) {
-			menu->count++;
-		} else {
-			TAILQ_REMOVE(&menu->results, item, result);
-		}
+/*
+ * Brings the results up to date with the edits made to the filter since the
+ * last call. Only the levels of the part of the filter that was never deleted
+ * are kept; one narrowing pass then matches whatever was typed after it.
+ */
+void
+menu_filter_apply(menu_t *menu)
+{
+	if (!menu->filter_pending) {
+		return;
+	}
 
-		item = next;
+	while ((menu->results_depth > 0) && (menu->results[menu->results_depth].length > menu->filter_matched)) {
+		menu->results_depth--;
 	}
 
-	menu_filter_update(menu);
+	if (menu->results[menu->results_depth].length < menu->filter_length) {
+		menu_results_narrow(menu);
+	} else {
+		menu_results_select(menu);
+	}
 
-	return 1;
+	menu_filter_update(menu);
 }
 
 int
 menu_filter_complete(menu_t *menu)
 {
-	int i;
+	int i, j;
 	menu_item_t *item;
 
-	item = TAILQ_FIRST(&menu->results);
+	menu_filter_apply(menu);
+
+	item = menu_result(menu, 0);
 	if (!item) {
 		return 0;
 	}
 
-	if (menu->filter_length > 0) {
-		free(menu->filter);
-	}
-
-	menu->filter = strdup(item->text);
+	menu_filter_reserve(menu, strlen(item->text) + 1);
 	menu->filter_length = strlen(item->text);
-	while ((item = TAILQ_NEXT(item, result)) != NULL) {
+	memcpy(menu->filter, item->text, menu->filter_length + 1);
+	for (j = 1; (item = menu_result(menu, j)) != NULL; j++) {
 		i = 0;
-		while (tolower(menu->filter[i]) == tolower(item->text[i])) {
+		while (menu->filter[i] && tolower(menu->filter[i]) == tolower(item->text[i])) {
 			i++;
 		}
 
@@ -468,36 +519,71 @@ menu_filter_complete(menu_t *menu)
 		menu->filter_length = i;
 	}
 
+	/*
+	 * The completed filter need not contain the one typed so far, so it is
+	 * matched against all entries rather than the current results.
+	 */
+	menu->results_depth = 0;
+	if (menu->filter_length > 0) {
+		menu_results_narrow(menu);
+	} else {
+		menu_results_select(menu);
+	}
+
+	menu_filter_update(menu);
+
 	return 1;
 }
 
+/*
+ * Shortens the filter to length bytes. The result levels of the longer
+ * filters are dropped once the edit is applied, so removing what was just
+ * typed needs no matching at all.
+ */
 int
-menu_filter_delete(menu_t *menu)
+menu_filter_delete(menu_t *menu, int length)
 {
-	menu_item_t *item;
-
-	while ((item = TAILQ_FIRST(&menu->results)) != NULL) {
-		TAILQ_REMOVE(&menu->results, item, result);
+	menu->filter_length = length;
+	menu->filter[length] = '\0';
+	if (menu->filter_matched > length) {
+		menu->filter_matched = length;
 	}
 
-	menu->count = 0;
-	TAILQ_FOREACH(item, &menu->items, item) {
-		if (!menu->filter || strcasestr(item->text, menu->filter)) {
-			TAILQ_INSERT_TAIL(&menu->results, item, result);
-			menu->count++;
-		}
+	menu->filter_pending = True;
+
+	return 1;
+}
+
+/*
+ * The filter lives in the menu's arena: growing it abandons the old buffer,
+ * so the capacity is doubled to keep the waste bounded.
+ */
+void
+menu_filter_reserve(menu_t *menu, size_t size)
+{
+	char *filter;
+
+	if (size <= menu->filter_size) {
+		return;
 	}
 
-	menu_filter_update(menu);
+	while (menu->filter_size < size) {
+		menu->filter_size *= 2;
+	}
 
-	return 1;
+	filter = arena_alloc(&menu->arena, menu->filter_size);
+	memcpy(filter, menu->filter, menu->filter_length + 1);
+	menu->filter = filter;
 }
 
 void
 menu_filter_update(menu_t *menu)
 {
-	menu->visible = TAILQ_FIRST(&menu->results);
-	if (menu->visible) {
+	menu->filter_matched = menu->filter_length;
+	menu->filter_pending = False;
+	menu->dirty_frame = True;
+	menu->visible = 0;
+	if (menu->count > 0) {
 		menu->selected_item = 0;
 		menu->selected_previous = 0;
 		menu->selected_visible = 0;
@@ -511,22 +597,46 @@ menu_filter_update(menu_t *menu)
 void
 menu_free(menu_t *menu)
 {
-	menu_item_t *item;
+	int i;
 
-	while ((item = TAILQ_FIRST(&menu->results)) != NULL) {
-		TAILQ_REMOVE(&menu->results, item, result);
+	for (i = 0; i < menu->results_size; i++) {
+		free(menu->results[i].indices);
+		free(menu->results[i].top);
 	}
 
-	while ((item = TAILQ_FIRST(&menu->items)) != NULL) {
-		free(item->text);
-		TAILQ_REMOVE(&menu->items, item, item);
-	}
+	free(menu->results);
+	free(menu->order);
+	free(menu->glyphs.specs);
+	free(menu->entries);
+	free(menu->pending);
+	arena_free(&menu->arena);
+	free(menu);
+}
 
-	if (menu->prompt) {
-		free(menu->prompt);
+/* Queues the text's glyphs for the next menu_glyphs_flush(). */
+void
+menu_glyphs_add(menu_t *menu, XftFont *font, int x, int y, const char *text)
+{
+	menu_glyphs_t *glyphs = &menu->glyphs;
+	int length;
+
+	length = strlen(text);
+	if (glyphs->count + length > glyphs->size) {
+		glyphs->size = MAX(glyphs->size * 2, glyphs->count + length);
+		glyphs->specs = realloc(glyphs->specs, glyphs->size * sizeof(XftGlyphFontSpec));
 	}
 
-	free(menu);
+	glyphs->count += glyph_layout(menu->state->display, font, text, x, y, glyphs->specs + glyphs->count);
+}
+
+/* Draws all queued glyphs in one color with a single request. */
+void
+menu_glyphs_flush(menu_t *menu, color_t color)
+{
+	if (menu->glyphs.count > 0) {
+		XftDrawGlyphFontSpec(menu->draw, &menu->state->colors[color], menu->glyphs.specs, menu->glyphs.count);
+		menu->glyphs.count = 0;
+	}
 }
 
 int
@@ -555,17 +665,7 @@ menu_handle_key(menu_t *menu, XKeyEvent *event)
 				wide_length++;
 			}
 
-			menu->filter_length -= wide_length;
-
-			if (menu->filter_length == 0) {
-				free(menu->filter);
-				menu->filter = NULL;
-			} else {
-				menu->filter = realloc(menu->filter, menu->filter_length + 1);
-				menu->filter[menu->filter_length] = '\0';
-			}
-
-			return menu_filter_delete(menu);
+			return menu_filter_delete(menu, menu->filter_length - wide_length);
 		case XK_KP_Enter:
 		case XK_Return:
 			return 2;
@@ -610,11 +710,7 @@ menu_handle_key(menu_t *menu, XKeyEvent *event)
 				return -1;
 			}
 
-			free(menu->filter);
-			menu->filter = NULL;
-			menu->filter_length = 0;
-
-			return menu_filter_delete(menu);
+			return menu_filter_delete(menu, 0);
 	}
 
 	if (!menu->prompt) {
@@ -643,7 +739,7 @@ menu_handle_move(menu_t *menu, int x, int y)
 		return False;
 	}
 
-	menu_draw_selection(menu, menu->selected_visible);
+	menu->selected_item = menu->visible + menu->selected_visible;
 
 	return True;
 }
@@ -663,7 +759,13 @@ menu_handle_release(menu_t *menu, int x, int y)
 }
 
 menu_t *
-menu_init(state_t *state, screen_t *screen, char *prompt, Bool cycle, void (*callback)(state_t *, void *))
+menu_init(
+		state_t *state,
+		screen_t *screen,
+		char *prompt,
+		Bool cycle,
+		void (*callback)(state_t *, void *),
+		void (*select)(state_t *, menu_t *, void *))
 {
 	menu_t *menu;
 	XGCValues values;
@@ -671,32 +773,19 @@ menu_init(state_t *state, screen_t *screen, char *prompt, Bool cycle, void (*cal
 	menu = calloc(1, sizeof(menu_t));
 	memset(menu, 0, sizeof(menu_t));
 
-	TAILQ_INIT(&menu->results);
 	TAILQ_INIT(&menu->items);
 
 	menu->screen = screen;
 	menu->state = state;
 	menu->callback = callback;
-	menu->window = XCreateSimpleWindow(
-			state->display,
-			state->root,
-			0,
-			0,
-			1,
-			1,
-			state->config->border_width,
-			state->colors[COLOR_BORDER_ACTIVE].pixel,
-			state->colors[COLOR_MENU_BACKGROUND].pixel);
-	menu->draw = XftDrawCreate(
-			state->display,
-			menu->window,
-			state->visual,
-			state->colormap);
+	menu->select = select;
 	if (prompt) {
-		menu->prompt = strdup(prompt);
+		menu->prompt = arena_strdup(&menu->arena, prompt);
 	} else {
 		menu->prompt = NULL;
 	}
+	menu->filter_size = 64;
+	menu->filter = arena_alloc(&menu->arena, menu->filter_size);
 	menu->selected_previous = -1;
 	menu->offset = 0;
 	menu->limit = 10; // state->config->menu_limit;
@@ -704,32 +793,61 @@ menu_init(state_t *state, screen_t *screen, char *prompt, Bool cycle, void (*cal
 	menu->border_width = state->config->border_width;
 	menu->cycle = cycle;
 
-	x_set_class_hint(state->display, menu->window, state->config->wm_name);
-
 	return menu;
 }
 
-int
-menu_move_down(menu_t *menu)
+/*
+ * Drops the cached menus, e.g. after the configuration or their contents
+ * changed. A cached menu that is currently open is freed when it closes.
+ */
+void
+menu_invalidate(state_t *state)
 {
-	menu_item_t *item;
-
-	if (menu->selected_item == menu->count - 1) {
-		return 0;
-	}
+	int i;
+	menu_t *menu;
 
-	if (menu->selected_visible == menu->limit - 1) {
-		item = TAILQ_NEXT(menu->visible, result);
-		if (!item) {
-			return 0;
+	for (i = 0; i < MENU_NITEMS; i++) {
+		menu = state->menus[i];
+		if (!menu) {
+			continue;
 		}
 
-		menu->visible = item;
-		menu->selected_item++;
-	} else {
-		menu->selected_item++;
-		menu->selected_visible++;
-	}
+		state->menus[i] = NULL;
+
+		if (state->menu == menu) {
+			menu->persistent = False;
+		} else {
+			menu_free(menu);
+		}
+	}
+}
+
+void
+menu_item_measure(menu_t *menu, menu_item_t *item)
+{
+	item->text_width = glyph_width(menu->state->display, menu->state->fonts[FONT_MENU_ITEM], item->text);
+
+	if (item->detail) {
+		item->detail_width = glyph_width(menu->state->display, menu->state->fonts[FONT_MENU_ITEM_DETAIL], item->detail);
+	}
+}
+
+int
+menu_move_down(menu_t *menu)
+{
+	menu_filter_apply(menu);
+
+	if (menu->selected_item == menu->count - 1) {
+		return 0;
+	}
+
+	if (menu->selected_visible == menu->limit - 1) {
+		menu->visible++;
+		menu->selected_item++;
+	} else {
+		menu->selected_item++;
+		menu->selected_visible++;
+	}
 
 	return 1;
 }
@@ -769,19 +887,18 @@ menu_move_right(menu_t *menu)
 int
 menu_move_up(menu_t *menu)
 {
-	menu_item_t *item;
+	menu_filter_apply(menu);
 
 	if (menu->selected_item == 0) {
 		return 0;
 	}
 
 	if (menu->selected_visible == 0) {
-		item = TAILQ_PREV(menu->visible, menu_item_q, result);
-		if (!item) {
+		if (menu->visible == 0) {
 			return 0;
 		}
 
-		menu->visible = item;
+		menu->visible--;
 		menu->selected_item--;
 	} else {
 		menu->selected_item--;
@@ -790,3 +907,661 @@ menu_move_up(menu_t *menu)
 
 	return 1;
 }
+
+/*
+ * Takes the next event off the queue if it is a key press for the menu,
+ * without waiting for one. Key releases in between only matter to cycling
+ * menus, so other menus skip them.
+ */
+Bool
+menu_next_key(menu_t *menu, XEvent *event)
+{
+	Display *display = menu->state->display;
+
+	while (XEventsQueued(display, QueuedAfterReading) > 0) {
+		XPeekEvent(display, event);
+		if (event->xany.window != menu->window) {
+			return False;
+		}
+
+		if ((event->type == KeyRelease) && !menu->cycle) {
+			XNextEvent(display, event);
+			continue;
+		}
+
+		if (event->type != KeyPress) {
+			return False;
+		}
+
+		XNextEvent(display, event);
+
+		return True;
+	}
+
+	return False;
+}
+
+void
+menu_remove(menu_t *menu, void *context)
+{
+	int count;
+	Bool removed = False;
+	menu_item_t *item, *next;
+
+	TAILQ_FOREACH_SAFE(item, &menu->items, item, next) {
+		if (item->context != context) {
+			continue;
+		}
+
+		TAILQ_REMOVE(&menu->items, item, item);
+		removed = True;
+	}
+
+	if (!removed || (menu->state->menu != menu)) {
+		return;
+	}
+
+	count = menu->count;
+	menu_results_build(menu);
+	if (menu->count == count) {
+		return;
+	}
+
+	if ((menu->count == 0) || (menu->cycle && (menu->count < 2))) {
+		menu_close(menu, True);
+		return;
+	}
+
+	menu->visible = 0;
+	menu->selected_item = MIN(menu->selected_item, menu->count - 1);
+	menu->selected_visible = menu->selected_item;
+	while (menu->selected_visible >= menu->limit) {
+		menu->visible++;
+		menu->selected_visible--;
+	}
+
+	menu_draw(menu);
+}
+
+/* Paints the prompt and all visible rows into the pixmap. */
+void
+menu_paint_frame(menu_t *menu)
+{
+	XftFont *font = menu->state->fonts[FONT_MENU_ITEM];
+
+	XftDrawRect(
+			menu->draw,
+			&menu->state->colors[COLOR_MENU_BACKGROUND],
+			0,
+			0,
+			menu->geometry.width,
+			menu->geometry.height);
+
+	if (menu->prompt) {
+		menu_glyphs_add(
+				menu,
+				menu->state->fonts[FONT_MENU_INPUT],
+				menu->padding,
+				menu->padding + menu->state->fonts[FONT_MENU_INPUT]->ascent,
+				menu->filter_length ? menu->filter : menu->prompt);
+		menu_glyphs_flush(menu, menu->filter_length ? COLOR_MENU_FOREGROUND : COLOR_MENU_PROMPT);
+
+		if (menu->count > 0) {
+			XftDrawRect(
+					menu->draw,
+					&menu->state->colors[COLOR_MENU_SEPARATOR],
+					0,
+					menu->offset - 1,
+					menu->geometry.width,
+					1);
+		}
+	}
+
+	if ((menu->selected_visible >= 0) && menu_result(menu, menu->visible + menu->selected_visible)) {
+		XftDrawRect(
+				menu->draw,
+				&menu->state->colors[COLOR_MENU_SELECTION_BACKGROUND],
+				0,
+				menu->offset + menu->padding + menu->selected_visible * (font->height + 1) + 1,
+				menu->geometry.width,
+				font->height + 1);
+	}
+
+	menu_paint_items(menu, 0, menu->limit);
+}
+
+/*
+ * Draws the text of the visible rows from first up to last, batched by color:
+ * the selected row's text in one request, everything else in another.
+ */
+void
+menu_paint_items(menu_t *menu, int first, int last)
+{
+	int i, y;
+	menu_item_t *item, *selected = NULL;
+	XftFont *font = menu->state->fonts[FONT_MENU_ITEM];
+
+	for (i = first; i < last; i++) {
+		item = menu_result(menu, menu->visible + i);
+		if (!item) {
+			break;
+		}
+
+		y = menu->offset + menu->padding + i * (font->height + 1) + font->ascent;
+		if (i == menu->selected_visible) {
+			selected = item;
+		} else {
+			menu_glyphs_add(menu, font, menu->padding, y, item->text);
+		}
+
+		if (item->detail) {
+			menu_glyphs_add(
+					menu,
+					menu->state->fonts[FONT_MENU_ITEM_DETAIL],
+					menu->geometry.width - menu->padding - item->detail_width,
+					y,
+					item->detail);
+		}
+	}
+
+	menu_glyphs_flush(menu, COLOR_MENU_FOREGROUND);
+
+	if (selected) {
+		y = menu->offset + menu->padding + menu->selected_visible * (font->height + 1) + font->ascent;
+		menu_glyphs_add(menu, font, menu->padding, y, selected->text);
+		menu_glyphs_flush(menu, COLOR_MENU_SELECTION_FOREGROUND);
+	}
+}
+
+/*
+ * Paints one row into the pixmap and returns the band it covers. Bands are
+ * the rows' selection rectangles, which reach one pixel into the next row's
+ * text, so that row's text is drawn too, clipped to the band.
+ */
+void
+menu_paint_row(menu_t *menu, int row, XRectangle *band)
+{
+	int top;
+	XftFont *font = menu->state->fonts[FONT_MENU_ITEM];
+
+	top = menu->offset + menu->padding + row * (font->height + 1);
+	band->x = 0;
+	band->y = (row == 0) ? top : top + 1;
+	band->width = menu->geometry.width;
+	band->height = top + font->height + 2 - band->y;
+
+	XftDrawSetClipRectangles(menu->draw, 0, 0, band, 1);
+
+	XftDrawRect(
+			menu->draw,
+			&menu->state->colors[COLOR_MENU_BACKGROUND],
+			band->x,
+			band->y,
+			band->width,
+			band->height);
+
+	if ((row == menu->selected_visible) && menu_result(menu, menu->visible + row)) {
+		XftDrawRect(
+				menu->draw,
+				&menu->state->colors[COLOR_MENU_SELECTION_BACKGROUND],
+				0,
+				top + 1,
+				menu->geometry.width,
+				font->height + 1);
+	}
+
+	menu_paint_items(menu, row, MIN(row + 2, menu->limit));
+
+	XftDrawSetClip(menu->draw, NULL);
+}
+
+/*
+ * Sizes the window for the current results, touching it only when its
+ * geometry actually changes, and makes sure the screen's pixmap can hold it.
+ */
+void
+menu_place(menu_t *menu)
+{
+	screen_t *screen = menu->screen;
+	state_t *state = menu->state;
+
+	menu->geometry.height = menu->offset + MIN(menu->limit, menu->count) * (state->fonts[FONT_MENU_ITEM]->height + 1);
+	if (menu->count > 0) {
+		menu->geometry.height += 2 * menu->padding;
+	}
+
+	if (memcmp(&screen->menu_geometry, &menu->geometry, sizeof(geometry_t))) {
+		XMoveResizeWindow(
+				state->display,
+				menu->window,
+				menu->geometry.x,
+				menu->geometry.y,
+				menu->geometry.width,
+				menu->geometry.height);
+		screen->menu_geometry = menu->geometry;
+		menu->dirty_frame = True;
+	}
+
+	if (!screen->menu_draw ||
+			(screen->menu_pixmap_width < menu->geometry.width) ||
+			(screen->menu_pixmap_height < menu->geometry.height)) {
+		if (screen->menu_draw) {
+			XFreePixmap(state->display, screen->menu_pixmap);
+		}
+
+		screen->menu_pixmap_width = MAX(screen->menu_pixmap_width, menu->geometry.width);
+		screen->menu_pixmap_height = MAX(screen->menu_pixmap_height, menu->geometry.height);
+		screen->menu_pixmap = XCreatePixmap(
+				state->display,
+				menu->window,
+				MAX(screen->menu_pixmap_width, 1),
+				MAX(screen->menu_pixmap_height, 1),
+				DefaultDepth(state->display, state->primary_screen));
+
+		if (screen->menu_draw) {
+			XftDrawChange(screen->menu_draw, screen->menu_pixmap);
+		} else {
+			screen->menu_draw = XftDrawCreate(state->display, screen->menu_pixmap, state->visual, state->colormap);
+		}
+
+		menu->dirty_frame = True;
+	}
+
+	menu->pixmap = screen->menu_pixmap;
+	menu->draw = screen->menu_draw;
+}
+
+/*
+ * Repaints after a key or pointer event, given the visible window and the
+ * selection from before it: a moved highlight costs two rows.
+ */
+void
+menu_redraw(menu_t *menu, int visible, int selected)
+{
+	if (menu->visible != visible) {
+		menu->dirty_frame = True;
+	} else if (menu->selected_visible != selected) {
+		menu_damage(menu, selected);
+		menu_damage(menu, menu->selected_visible);
+	}
+
+	menu_render(menu);
+}
+
+/*
+ * Paints what was damaged since the last call into the off-screen pixmap and
+ * copies only those parts to the window.
+ */
+void
+menu_render(menu_t *menu)
+{
+	int i;
+	menu_item_t *item;
+	XRectangle band;
+	Bool selection = False;
+
+	menu_place(menu);
+
+	if (menu->dirty_frame) {
+		menu_paint_frame(menu);
+		XCopyArea(
+				menu->state->display,
+				menu->pixmap,
+				menu->window,
+				menu->gc,
+				0,
+				0,
+				menu->geometry.width,
+				menu->geometry.height,
+				0,
+				0);
+		selection = True;
+	} else {
+		for (i = 0; (i < menu->limit) && (i < 64); i++) {
+			if (!(menu->dirty_rows & (1ull << i))) {
+				continue;
+			}
+
+			menu_paint_row(menu, i, &band);
+			XCopyArea(
+					menu->state->display,
+					menu->pixmap,
+					menu->window,
+					menu->gc,
+					band.x,
+					band.y,
+					band.width,
+					band.height,
+					band.x,
+					band.y);
+
+			if (i == menu->selected_visible) {
+				selection = True;
+			}
+		}
+	}
+
+	menu->dirty_frame = False;
+	menu->dirty_rows = 0;
+
+	if (selection && menu->callback && (menu->selected_visible >= 0)) {
+		item = menu_result(menu, menu->visible + menu->selected_visible);
+		if (item) {
+			menu->callback(menu->state, item->context);
+		}
+	}
+}
+
+/* Returns a persistent menu to the state menu_init() left it in. */
+void
+menu_reset(menu_t *menu)
+{
+	menu->results_depth = 0;
+	menu->filter[0] = '\0';
+	menu->filter_length = 0;
+	menu->filter_matched = 0;
+	menu->filter_pending = False;
+	memset(&menu->geometry, 0, sizeof(geometry_t));
+	menu->offset = 0;
+	menu->count = 0;
+	menu->selected_item = 0;
+	menu->selected_previous = -1;
+	menu->selected_visible = 0;
+	menu->visible = 0;
+}
+
+/* Returns the i-th entry matching the current filter, or NULL. */
+menu_item_t *
+menu_result(menu_t *menu, int i)
+{
+	menu_results_t *level = &menu->results[menu->results_depth];
+
+	if ((i < 0) || (i >= menu->count)) {
+		return NULL;
+	}
+
+	return menu->entries[level->top_count ? menu->order[i] : level->indices[i]];
+}
+
+/*
+ * Indexes the linked items and makes the bottom of the result stack match
+ * all of them, then narrows it by the filter typed so far, if any. Entries
+ * launched before are listed first, by frecency; narrowing keeps that order.
+ */
+void
+menu_results_build(menu_t *menu)
+{
+	int i, j, ranked = 0;
+	unsigned int index;
+	menu_item_t *item;
+	menu_results_t *level;
+
+	menu->entry_count = 0;
+	TAILQ_FOREACH(item, &menu->items, item) {
+		if (menu->entry_count == menu->entry_size) {
+			menu->entry_size = menu->entry_size ? menu->entry_size * 2 : 256;
+			menu->entries = realloc(menu->entries, menu->entry_size * sizeof(menu_item_t *));
+		}
+
+		menu->entries[menu->entry_count++] = item;
+	}
+
+	menu->results_depth = -1;
+	level = menu_results_push(menu);
+	for (i = 0; i < menu->entry_count; i++) {
+		if (menu->entries[i]->rank == 0) {
+			continue;
+		}
+
+		/* few entries have a history, so insertion sort does */
+		for (j = ranked++; (j > 0) && (menu->entries[level->indices[j - 1]]->rank < menu->entries[i]->rank); j--) {
+			level->indices[j] = level->indices[j - 1];
+		}
+
+		level->indices[j] = i;
+	}
+
+	for (i = 0, index = ranked; i < menu->entry_count; i++) {
+		if (menu->entries[i]->rank == 0) {
+			level->indices[index++] = i;
+		}
+	}
+
+	level->count = menu->entry_count;
+	level->length = 0;
+
+	if (menu->filter_length > 0) {
+		menu_results_narrow(menu);
+	} else {
+		menu_results_select(menu);
+	}
+}
+
+/*
+ * Pushes the entries of the current level that match the whole filter. With
+ * fuzzy matching every match is scored, but only the best menu->limit ones
+ * are kept in order; the others follow them in menu order.
+ */
+void
+menu_results_narrow(menu_t *menu)
+{
+	int i, score;
+	unsigned int index;
+	match_t match;
+	menu_rank_t rank;
+	menu_results_t *level, *parent;
+
+	level = menu_results_push(menu);
+	parent = level - 1;
+
+	match_init(&match, menu->filter);
+	level->count = 0;
+	for (i = 0; i < parent->count; i++) {
+		index = parent->indices[i];
+		if ((menu->entries[index]->signature & match.signature) != match.signature) {
+			continue;
+		}
+
+		if (menu->state->config->menu_match == MENU_MATCH_FUZZY) {
+			score = match_score(&match, menu->entries[index]->text);
+			if (score < 0) {
+				continue;
+			}
+
+			menu_results_rank(menu, level, score);
+		} else if (!match_find(&match, menu->entries[index]->text)) {
+			continue;
+		}
+
+		level->indices[level->count++] = index;
+	}
+
+	match_free(&match);
+
+	/* Popping the heap's minimum repeatedly leaves it sorted best first. */
+	for (i = level->top_count - 1; i > 0; i--) {
+		rank = level->top[0];
+		level->top[0] = level->top[i];
+		menu_results_sift(level->top, i);
+		level->top[i] = rank;
+	}
+
+	level->length = menu->filter_length;
+	menu_results_select(menu);
+}
+
+/*
+ * Returns a new top level able to hold every entry. Popped levels keep their
+ * buffers, so typing after a backspace does not allocate.
+ */
+menu_results_t *
+menu_results_push(menu_t *menu)
+{
+	menu_results_t *level;
+
+	if (menu->results_depth + 1 == menu->results_size) {
+		menu->results_size = menu->results_size ? menu->results_size * 2 : 16;
+		menu->results = realloc(menu->results, menu->results_size * sizeof(menu_results_t));
+		memset(menu->results + menu->results_depth + 1, 0, (menu->results_size - menu->results_depth - 1) * sizeof(menu_results_t));
+	}
+
+	level = &menu->results[++menu->results_depth];
+	if (level->size < menu->entry_count) {
+		level->size = menu->entry_count;
+		level->indices = realloc(level->indices, level->size * sizeof(unsigned int));
+	}
+
+	if (level->top_size < menu->limit) {
+		level->top_size = menu->limit;
+		level->top = realloc(level->top, level->top_size * sizeof(menu_rank_t));
+	}
+
+	level->count = 0;
+	level->length = 0;
+	level->top_count = 0;
+
+	return level;
+}
+
+/*
+ * Offers an entry to the level's top ranks, a min-heap of at most
+ * menu->limit entries whose root is the worst of them.
+ */
+void
+menu_results_rank(menu_t *menu, menu_results_t *level, int score)
+{
+	int i, parent;
+	menu_rank_t rank = { score, level->count };
+
+	if (level->top_count < menu->limit) {
+		for (i = level->top_count++; i > 0; i = parent) {
+			parent = (i - 1) / 2;
+			if (!MENU_RANK_WORSE(rank, level->top[parent])) {
+				break;
+			}
+
+			level->top[i] = level->top[parent];
+		}
+
+		level->top[i] = rank;
+	} else if (MENU_RANK_WORSE(level->top[0], rank)) {
+		level->top[0] = rank;
+		menu_results_sift(level->top, level->top_count);
+	}
+}
+
+/*
+ * Makes the top level the current results. When it is ranked, the listing
+ * order is its top entries followed by the rest of its matches.
+ */
+void
+menu_results_select(menu_t *menu)
+{
+	int i, j, n = 0;
+	menu_results_t *level = &menu->results[menu->results_depth];
+
+	menu->count = level->count;
+	if (level->top_count == 0) {
+		return;
+	}
+
+	if (menu->order_size < level->count) {
+		menu->order_size = level->count;
+		menu->order = realloc(menu->order, menu->order_size * sizeof(unsigned int));
+	}
+
+	for (i = 0; i < level->top_count; i++) {
+		menu->order[n++] = level->indices[level->top[i].position];
+	}
+
+	for (i = 0; i < level->count; i++) {
+		for (j = 0; j < level->top_count; j++) {
+			if (level->top[j].position == i) {
+				break;
+			}
+		}
+
+		if (j == level->top_count) {
+			menu->order[n++] = level->indices[i];
+		}
+	}
+}
+
+/* Restores the heap property of count ranks after their root changed. */
+void
+menu_results_sift(menu_rank_t *top, int count)
+{
+	int i = 0, child;
+	menu_rank_t rank = top[0];
+
+	while ((child = 2 * i + 1) < count) {
+		if ((child + 1 < count) && MENU_RANK_WORSE(top[child + 1], top[child])) {
+			child++;
+		}
+
+		if (!MENU_RANK_WORSE(top[child], rank)) {
+			break;
+		}
+
+		top[i] = top[child];
+		i = child;
+	}
+
+	top[i] = rank;
+}
+
+/*
+ * Links the items queued by sorted menu_add() calls: they are sorted once with
+ * the configured comparator, duplicates are dropped (the first one added wins)
+ * and the result is merged into the already linked items.
+ */
+void
+menu_sort(menu_t *menu)
+{
+	int (*compare)(const void *, const void *);
+	menu_item_t *current, *item, *previous = NULL;
+	size_t i;
+
+	if (menu->pending_count == 0) {
+		return;
+	}
+
+	if (menu->state->config->menu_sort == MENU_SORT_LOCALE) {
+		compare = menu_compare_locale;
+	} else {
+		compare = menu_compare_bytes;
+	}
+
+	qsort(menu->pending, menu->pending_count, sizeof(menu_item_t *), compare);
+
+	current = TAILQ_FIRST(&menu->items);
+	for (i = 0; i < menu->pending_count; i++) {
+		item = menu->pending[i];
+		if (previous && !strcmp(previous->text, item->text)) {
+			continue;
+		}
+
+		previous = item;
+
+		while (current && (compare(&current, &item) < 0)) {
+			current = TAILQ_NEXT(current, item);
+		}
+
+		if (current && !strcmp(current->text, item->text)) {
+			continue;
+		}
+
+		menu_item_measure(menu, item);
+
+		if (current) {
+			TAILQ_INSERT_BEFORE(current, item, item);
+		} else {
+			TAILQ_INSERT_TAIL(&menu->items, item, item);
+		}
+	}
+
+	free(menu->pending);
+	menu->pending = NULL;
+	menu->pending_count = 0;
+	menu->pending_size = 0;
+}
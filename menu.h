@@ -1,9 +1,13 @@
 #ifndef __MENU_H__
 #define __MENU_H__
 
+#include <stdint.h>
+#include <stdio.h>
+
 #include <X11/extensions/Xrender.h>
 #include <X11/Xft/Xft.h>
 
+#include "arena.h"
 #include "queue.h"
 #include "xutils.h"
 
@@ -14,7 +18,6 @@ TAILQ_HEAD(menu_item_q, menu_item_t);
 
 typedef struct menu_item_t {
 	TAILQ_ENTRY(menu_item_t) item;
-	TAILQ_ENTRY(menu_item_t) result;
 	void *context;
 
 	char *text;
@@ -22,41 +25,116 @@ typedef struct menu_item_t {
 
 	int text_width;
 	int detail_width;
+
+	size_t order;
+	double rank;
+	uint64_t signature;
 } menu_item_t;
 
+/* Glyphs of one color, drawn with a single XftDrawGlyphFontSpec() call. */
+typedef struct menu_glyphs_t {
+	XftGlyphFontSpec *specs;
+	int count;
+	int size;
+} menu_glyphs_t;
+
+typedef struct menu_rank_t {
+	int score;
+	int position;
+} menu_rank_t;
+
+/*
+ * One level of the filter's result stack: the entries matching the first
+ * length bytes of the filter, as indices into menu_t.entries. With fuzzy
+ * matching, top holds the best scoring entries, which are listed first.
+ */
+typedef struct menu_results_t {
+	unsigned int *indices;
+	int count;
+	int size;
+	int length;
+
+	menu_rank_t *top;
+	int top_count;
+	int top_size;
+} menu_results_t;
+
 typedef struct menu_t {
 	struct screen_t *screen;
 	struct state_t *state;
 
 	void (*callback)(struct state_t *, void *);
+	void (*select)(struct state_t *, struct menu_t *, void *);
 
 	Window window;
 	XftDraw *draw;
+	Pixmap pixmap;
+	GC gc;
+	Bool dirty_frame;
+	uint64_t dirty_rows;
+	menu_glyphs_t glyphs;
+	Window focus;
+	int focus_revert;
 
 	geometry_t geometry;
 	int offset;
 
 	Bool cycle;
+	Bool persistent;
+	unsigned long generation;
+	const char *history;
 	int padding;
 	char *prompt;
 	char *filter;
 	int filter_length;
+	size_t filter_size;
+	int filter_matched;
+	Bool filter_pending;
 	int border_width;
 
 	struct menu_item_q items;
-	struct menu_item_q results;
+	menu_item_t **entries;
+	int entry_count;
+	int entry_size;
+
+	menu_results_t *results;
+	int results_depth;
+	int results_size;
+	unsigned int *order;
+	int order_size;
+
+	menu_item_t **pending;
+	size_t pending_count;
+	size_t pending_size;
 
 	int count;
 	int limit;
 	int selected_item;
 	int selected_previous;
 	int selected_visible;
-	menu_item_t *visible;
+	int visible;
+
+	arena_t arena;
 } menu_t;
 
-void menu_add(menu_t *, void *, Bool, char *, char *);
-void *menu_filter(menu_t *);
+menu_item_t *menu_add(menu_t *, void *, Bool, char *, char *);
+void menu_close(menu_t *, Bool);
 void menu_free(menu_t *);
-menu_t *menu_init(struct state_t *, struct screen_t *, char *, Bool, void (*)(struct state_t *, void *));
+Bool menu_handle_event(menu_t *, XEvent *);
+menu_t *menu_init(
+		struct state_t *,
+		struct screen_t *,
+		char *,
+		Bool,
+		void (*)(struct state_t *, void *),
+		void (*)(struct state_t *, struct menu_t *, void *));
+void menu_invalidate(struct state_t *);
+Bool menu_open(menu_t *);
+void menu_remove(menu_t *, void *);
+
+#ifdef MENU_STATS
+void menu_dump(FILE *);
+#endif /* MENU_STATS */
+void menu_sort(menu_t *);
 
 #endif /* __MENU_H__ */
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "utils.h"
+
+#define POOL_ALIGN (sizeof(void *) > sizeof(double) ? sizeof(void *) : sizeof(double))
+#define POOL_ROUND(x) (((x) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1))
+
+void pool_grow(pool_t *);
+
+pool_t *pools = NULL;
+
+void *
+pool_alloc(pool_t *pool)
+{
+	void *object;
+
+	if (!pool->free_list) {
+		pool_grow(pool);
+	}
+
+	object = pool->free_list;
+	pool->free_list = *(void **)object;
+
+#ifdef POOL_STATS
+	pool->allocations++;
+	if (++pool->live > pool->peak) {
+		pool->peak = pool->live;
+	}
+#endif /* POOL_STATS */
+
+	return memset(object, 0, pool->size);
+}
+
+#ifdef POOL_STATS
+void
+pool_dump(FILE *stream)
+{
+	pool_t *pool;
+
+	for (pool = pools; pool; pool = pool->next) {
+		fprintf(
+				stream,
+				"pool %s: %lu live, %lu peak, %lu allocations, %zu bytes\n",
+				pool->name,
+				pool->live,
+				pool->peak,
+				pool->allocations,
+				pool->bytes);
+	}
+}
+#endif /* POOL_STATS */
+
+void
+pool_free(pool_t *pool, void *object)
+{
+	if (!object) {
+		return;
+	}
+
+	*(void **)object = pool->free_list;
+	pool->free_list = object;
+
+#ifdef POOL_STATS
+	pool->live--;
+#endif /* POOL_STATS */
+}
+
+void
+pool_grow(pool_t *pool)
+{
+	char *object;
+	pool_slab_t *slab;
+	size_t i, size;
+
+	if (!pool->slabs) {
+		pool->size = POOL_ROUND(MAX(pool->size, sizeof(void *)));
+		pool->next = pools;
+		pools = pool;
+	}
+
+	size = POOL_ROUND(sizeof(pool_slab_t)) + pool->count * pool->size;
+	slab = malloc(size);
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+
+	object = (char *)slab + POOL_ROUND(sizeof(pool_slab_t));
+	for (i = 0; i < pool->count; i++, object += pool->size) {
+		*(void **)object = pool->free_list;
+		pool->free_list = object;
+	}
+
+#ifdef POOL_STATS
+	pool->bytes += size;
+#endif /* POOL_STATS */
+}
@@ -0,0 +1,44 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Fixed-size object pools. Objects are carved out of slabs which are never
+ * handed back to malloc; freed objects go on a free-list and are reused by the
+ * next allocation of the same type. Build with -DPOOL_STATS to keep live, peak
+ * and byte counters per pool.
+ */
+
+typedef struct pool_slab_t {
+	struct pool_slab_t *next;
+} pool_slab_t;
+
+typedef struct pool_t {
+	const char *name;
+	size_t size;
+	size_t count;
+
+	void *free_list;
+	pool_slab_t *slabs;
+	struct pool_t *next;
+
+#ifdef POOL_STATS
+	unsigned long live;
+	unsigned long peak;
+	unsigned long allocations;
+	size_t bytes;
+#endif /* POOL_STATS */
+} pool_t;
+
+#define POOL_INITIALIZER(name, type, count) { name, sizeof(type), count, NULL, NULL, NULL }
+
+void *pool_alloc(pool_t *);
+void pool_free(pool_t *, void *);
+
+#ifdef POOL_STATS
+void pool_dump(FILE *);
+#endif /* POOL_STATS */
+
+#endif /* __POOL_H__ */
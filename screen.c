@@ -5,8 +5,10 @@
 #include "client.h"
 #include "desktop.h"
 #include "group.h"
+#include "menu.h"
 #include "screen.h"
 #include "state.h"
+#include "table.h"
 
 void
 screen_activate(state_t *state, screen_t *screen)
@@ -32,7 +34,7 @@ screen_adopt(state_t *state, screen_t *screen, client_t *client)
 	geometry_t screen_area;
 	group_t *group;
 
-	group_unassign(client);
+	group_unassign(state, client);
 
 	group = group_assign(screen->desktops[screen->desktop_index], client);
 	group->desktop = screen->desktops[screen->desktop_index];
@@ -67,31 +69,29 @@ screen_adopt(state_t *state, screen_t *screen, client_t *client)
 geometry_t
 screen_available_area(screen_t *screen)
 {
-	client_t *client;
 	geometry_t geometry = screen->geometry;
-	group_t *group;
-	int i;
+	size_t i;
 	long bottom = 0, difference, left = 0, right = 0, top = 0;
 
-	for (i = 0; i < screen->desktop_count; i++) {
-		TAILQ_FOREACH(group, &screen->desktops[i]->groups, entry) {
-			TAILQ_FOREACH(client, &group->clients, entry) {
-				if (client->strut.bottom > bottom) {
-					bottom = client->strut.bottom;
-				}
-
-				if (client->strut.left > left) {
-					left = client->strut.left;
-				}
-
-				if (client->strut.right > right) {
-					right = client->strut.right;
-				}
-
-				if (client->strut.top > top) {
-					top = client->strut.top;
-				}
-			}
+	for (i = 0; i < table.count; i++) {
+		if (table.screens[i] != screen) {
+			continue;
+		}
+
+		if (table.struts[i].bottom > bottom) {
+			bottom = table.struts[i].bottom;
+		}
+
+		if (table.struts[i].left > left) {
+			left = table.struts[i].left;
+		}
+
+		if (table.struts[i].right > right) {
+			right = table.struts[i].right;
+		}
+
+		if (table.struts[i].top > top) {
+			top = table.struts[i].top;
 		}
 	}
 
@@ -240,7 +240,7 @@ screen_for_point(state_t *state, int x, int y)
 }
 
 void
-screen_free(screen_t *screen)
+screen_free(state_t *state, screen_t *screen)
 {
 	int i;
 
@@ -248,6 +248,20 @@ screen_free(screen_t *screen)
 		return;
 	}
 
+	if (state->menu && (state->menu->screen == screen)) {
+		menu_close(state->menu, True);
+	}
+
+	if (screen->menu_window != None) {
+		if (screen->menu_draw) {
+			XftDrawDestroy(screen->menu_draw);
+			XFreePixmap(state->display, screen->menu_pixmap);
+		}
+
+		XFreeGC(state->display, screen->menu_gc);
+		XDestroyWindow(state->display, screen->menu_window);
+	}
+
 	for (i = 0; i < screen->desktop_count; i++) {
 		desktop_free(screen->desktops[i]);
 	}
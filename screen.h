@@ -2,6 +2,7 @@
 #define __SCREEN_H__
 
 #include <X11/extensions/Xrandr.h>
+#include <X11/Xft/Xft.h>
 
 #include "queue.h"
 #include "xutils.h"
@@ -19,7 +20,16 @@ typedef struct screen_t {
 	Bool wired;
 	unsigned long mm_width;
 	unsigned long mm_height;
-	
+	double refresh_rate;
+
+	Window menu_window;
+	XftDraw *menu_draw;
+	Pixmap menu_pixmap;
+	GC menu_gc;
+	int menu_pixmap_width;
+	int menu_pixmap_height;
+	geometry_t menu_geometry;
+
 	geometry_t geometry;
 
 	struct desktop_t **desktops;
@@ -39,7 +49,7 @@ screen_t *screen_find_right(struct state_t *, screen_t *);
 screen_t *screen_for_client(struct state_t *, struct client_t *);
 screen_t *screen_for_point(struct state_t *, int, int);
 screen_t *screen_find_unwired(struct state_t *);
-void screen_free(screen_t *);
+void screen_free(struct state_t *, screen_t *);
 screen_t *screen_init(struct state_t *, char *, RRCrtc, geometry_t, unsigned long, unsigned long);
 void screen_update_geometry(struct state_t *, screen_t *, geometry_t);
 
@@ -1,24 +1,66 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif /* __linux__ */
+
+#include <X11/Xatom.h>
 #include <X11/extensions/Xrandr.h>
 
 #include "client.h"
 #include "config.h"
 #include "desktop.h"
 #include "ewmh.h"
+#include "exec.h"
+#include "glyph.h"
 #include "group.h"
+#include "history.h"
 #include "icccm.h"
+#include "menu.h"
+#include "pool.h"
 #include "screen.h"
 #include "state.h"
+#include "table.h"
 #include "utils.h"
 #include "xutils.h"
 
+Bool state_alloc_color(state_t *, char *, XftColor *);
 void state_bind(state_t *);
+int state_compare_order(const void *, const void *);
+double state_crtc_refresh_rate(XRRScreenResources *, XRRCrtcInfo *);
 int state_error_handler(Display *, XErrorEvent *);
+void state_grab_key(state_t *, binding_t *);
+Bool state_has_key(struct binding_q *, binding_t *);
+XftFont *state_open_font(state_t *, char *);
+void state_rebind(state_t *, config_t *);
+void state_restore_desktops(state_t *);
 Bool state_update_clients(state_t *);
 Bool state_update_screens(state_t *);
+void state_watch(state_t *);
+
+#define STATE_MAX_SCREENS 16
+
+/* A restored client and its place in the order saved before the restart. */
+typedef struct state_order_t {
+	client_t *client;
+	long group;
+	long position;
+} state_order_t;
+
+Bool
+state_alloc_color(state_t *state, char *name, XftColor *color)
+{
+	if (!XftColorAllocName(state->display, state->visual, state->colormap, name, color)) {
+		fprintf(stderr, "Invalid color: %s\n", name);
+		return False;
+	}
+
+	return True;
+}
 
 void
 state_bind(state_t *state)
@@ -41,15 +83,40 @@ state_bind(state_t *state)
 			None);
 
 	TAILQ_FOREACH(binding, &state->config->keybindings, entry) {
-		XGrabKey(
-				state->display,
-				XKeysymToKeycode(state->display, binding->button),
-				binding->modifier,
-				state->root,
-				True,
-				GrabModeAsync,
-				GrabModeAsync);
+		state_grab_key(state, binding);
+	}
+}
+
+int
+state_compare_order(const void *a, const void *b)
+{
+	const state_order_t *x = a, *y = b;
+
+	if (x->group != y->group) {
+		return x->group < y->group ? -1 : 1;
+	}
+
+	if (x->client->group != y->client->group) {
+		return (uintptr_t)x->client->group < (uintptr_t)y->client->group ? -1 : 1;
+	}
+
+	return (x->position > y->position) - (x->position < y->position);
+}
+
+double
+state_crtc_refresh_rate(XRRScreenResources *resources, XRRCrtcInfo *crtc)
+{
+	int i;
+	XRRModeInfo *mode;
+
+	for (i = 0; i < resources->nmode; i++) {
+		mode = &resources->modes[i];
+		if ((mode->id == crtc->mode) && mode->hTotal && mode->vTotal) {
+			return (double)mode->dotClock / ((double)mode->hTotal * mode->vTotal);
+		}
 	}
+
+	return 0;
 }
 
 int
@@ -65,6 +132,33 @@ state_error_handler(Display *display, XErrorEvent *event)
 	return 0;
 }
 
+void
+state_grab_key(state_t *state, binding_t *binding)
+{
+	XGrabKey(
+			state->display,
+			XKeysymToKeycode(state->display, binding->button),
+			binding->modifier,
+			state->root,
+			True,
+			GrabModeAsync,
+			GrabModeAsync);
+}
+
+Bool
+state_has_key(struct binding_q *bindings, binding_t *key)
+{
+	binding_t *binding;
+
+	TAILQ_FOREACH(binding, bindings, entry) {
+		if ((binding->button == key->button) && (binding->modifier == key->modifier)) {
+			return True;
+		}
+	}
+
+	return False;
+}
+
 void
 state_flush(state_t *state)
 {
@@ -84,11 +178,29 @@ state_free(state_t *state)
 	XUngrabPointer(state->display, CurrentTime);
 	XUngrabKeyboard(state->display, CurrentTime);
 
+	if (state->menu && !state->menu->persistent) {
+		menu_free(state->menu);
+	}
+
+	state->menu = NULL;
+	menu_invalidate(state);
+
+	animation_free(state);
+
 	while ((screen = TAILQ_FIRST(&state->screens)) != NULL) {
 		TAILQ_REMOVE(&state->screens, screen, entry);
-		screen_free(screen);
+		screen_free(state, screen);
 	}
 
+	if (state->watch != -1) {
+		close(state->watch);
+	}
+
+	table_free();
+	exec_free();
+	history_free();
+	glyph_free();
+
 	for (i = 0; i < COLOR_NITEMS; i++) {
 		XftColorFree(state->display, state->visual, state->colormap, &state->colors[i]);
 	}
@@ -109,16 +221,24 @@ state_free(state_t *state)
 	icccm_free(state->icccm);
 
 	free(state);
+
+#ifdef MENU_STATS
+	menu_dump(stderr);
+#endif /* MENU_STATS */
+
+#ifdef POOL_STATS
+	pool_dump(stderr);
+#endif /* POOL_STATS */
 }
 
 state_t *
 state_init(char *display_name)
 {
-	int error_base, i, result;
+	int error_base, i;
 	state_t *state;
 	XSetWindowAttributes attributes;
 
-	state = malloc(sizeof(state_t));
+	state = calloc(1, sizeof(state_t));
 	state->display = XOpenDisplay(display_name);
 	if (!state->display) {
 		fprintf(stderr, "Can't open display %s\n", XDisplayName(display_name));
@@ -134,6 +254,7 @@ state_init(char *display_name)
 	state->visual = DefaultVisual(state->display, state->primary_screen);
 	state->root = RootWindow(state->display, state->primary_screen);
 	state->fd = ConnectionNumber(state->display);
+	state->magnetwm_state = XInternAtom(state->display, "_MAGNETWM_STATE", False);
 	state->config = config_init();
 
 	state->cursors[CURSOR_NORMAL] = XCreateFontCursor(state->display, XC_left_ptr);
@@ -145,32 +266,19 @@ state_init(char *display_name)
 
 	state->colors = calloc(COLOR_NITEMS, sizeof(XftColor));
 	for (i = 0; i < COLOR_NITEMS; i++) {
-		result = XftColorAllocName(
-				state->display,
-				state->visual,
-				state->colormap,
-				state->config->colors[i],
-				&state->colors[i]);
-		if (!result) {
-			fprintf(stderr, "Invalid color: %s\n", state->config->colors[i]);
-		}
+		state_alloc_color(state, state->config->colors[i], &state->colors[i]);
 	}
 
 	state->fonts = calloc(FONT_NITEMS, sizeof(XftFont *));
-	memset(state->fonts, 0, sizeof(XftFont *));
 	for (i = 0; i < FONT_NITEMS; i++) {
-		state->fonts[i] = XftFontOpenXlfd(state->display, state->primary_screen, state->config->fonts[i]);
-
-		if (!state->fonts[i]) {
-			state->fonts[i] = XftFontOpenName(state->display, state->primary_screen, state->config->fonts[i]);
-		}
-
-		if (!state->fonts[i]) {
-			fprintf(stderr, "Invalid font: %s\n", state->config->fonts[i]);
-		}
+		state->fonts[i] = state_open_font(state, state->config->fonts[i]);
 	}
 
+	state->watch = -1;
+	state_watch(state);
+
 	TAILQ_INIT(&state->screens);
+	TAILQ_INIT(&state->animations);
 
 	if (!XRRQueryExtension(state->display, &state->xrandr_event_base, &error_base)) {
 		fprintf(stderr, "RandR extension missing\n");
@@ -186,6 +294,8 @@ state_init(char *display_name)
 		return NULL;
 	}
 
+	state_restore_desktops(state);
+
 	if (!state_update_clients(state)) {
 		state_free(state);
 		return NULL;
@@ -220,25 +330,316 @@ state_init(char *display_name)
 	return state;
 }
 
+XftFont *
+state_open_font(state_t *state, char *name)
+{
+	XftFont *font;
+
+	font = XftFontOpenXlfd(state->display, state->primary_screen, name);
+	if (!font) {
+		font = XftFontOpenName(state->display, state->primary_screen, name);
+	}
+
+	if (!font) {
+		fprintf(stderr, "Invalid font: %s\n", name);
+	}
+
+	return font;
+}
+
+/*
+ * Reads the events queued on the watch descriptor and reloads the
+ * configuration if one of them concerns the configuration file.
+ */
+void
+state_process_watch(state_t *state)
+{
+#ifdef __linux__
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char *name;
+	Bool changed = False;
+	ssize_t length, offset;
+	struct inotify_event *event;
+
+	name = strrchr(state->config->path, '/') + 1;
+	while ((length = read(state->watch, buffer, sizeof(buffer))) > 0) {
+		for (offset = 0; offset < length; offset += sizeof(struct inotify_event) + event->len) {
+			event = (struct inotify_event *)(buffer + offset);
+			if (event->len && !strcmp(event->name, name)) {
+				changed = True;
+			}
+		}
+	}
+
+	if (changed) {
+		state_reload(state);
+	}
+#endif /* __linux__ */
+}
+
+/*
+ * Grabs the keys bound only by the current configuration and ungrabs those
+ * bound only by the previous one; grabs both share are left alone.
+ */
+void
+state_rebind(state_t *state, config_t *previous)
+{
+	binding_t *binding;
+
+	TAILQ_FOREACH(binding, &previous->keybindings, entry) {
+		if (!state_has_key(&state->config->keybindings, binding)) {
+			XUngrabKey(
+					state->display,
+					XKeysymToKeycode(state->display, binding->button),
+					binding->modifier,
+					state->root);
+		}
+	}
+
+	TAILQ_FOREACH(binding, &state->config->keybindings, entry) {
+		if (!state_has_key(&previous->keybindings, binding)) {
+			state_grab_key(state, binding);
+		}
+	}
+}
+
+/*
+ * Rereads the configuration and applies it without restarting: only changed
+ * key grabs, colors and fonts are redone before the borders are redrawn. A
+ * configuration with errors is discarded and the current one kept.
+ */
 Bool
-state_update_clients(state_t *state)
+state_reload(state_t *state)
 {
+	Bool borders, fonts = False;
+	XftColor color;
+	XftFont *font;
 	client_t *client;
+	config_t *config, *previous = state->config;
 	screen_t *screen;
-	unsigned int count, i;
+	size_t i;
+
+	config = config_init();
+	if (config->errors > 0) {
+		fprintf(stderr, "Keeping the previous configuration\n");
+		config_free(config);
+		return False;
+	}
+
+	if (state->menu) {
+		menu_close(state->menu, True);
+	}
+
+	state->config = config;
+	state_rebind(state, previous);
+
+	borders = (config->border_width != previous->border_width);
+	for (i = 0; i < COLOR_NITEMS; i++) {
+		if (!strcmp(config->colors[i], previous->colors[i])) {
+			continue;
+		}
+
+		if (state_alloc_color(state, config->colors[i], &color)) {
+			XftColorFree(state->display, state->visual, state->colormap, &state->colors[i]);
+			state->colors[i] = color;
+			borders = True;
+		}
+	}
+
+	for (i = 0; i < FONT_NITEMS; i++) {
+		if (!strcmp(config->fonts[i], previous->fonts[i])) {
+			continue;
+		}
+
+		font = state_open_font(state, config->fonts[i]);
+		if (font) {
+			if (state->fonts[i]) {
+				XftFontClose(state->display, state->fonts[i]);
+			}
+
+			state->fonts[i] = font;
+			fonts = True;
+		}
+	}
+
+	/* the glyph caches are keyed by font, which may be reused by a new one */
+	if (fonts) {
+		glyph_free();
+	}
+
+	if (borders) {
+		for (i = 0; i < table.count; i++) {
+			client = table.clients[i];
+			if (!client) {
+				continue;
+			}
+
+			if (!(client->flags & (CLIENT_FULLSCREEN | CLIENT_IGNORE))) {
+				client->border_width = client_border_width(state, client);
+			}
+
+			client_draw_border(state, client);
+		}
+
+		TAILQ_FOREACH(screen, &state->screens, entry) {
+			if (screen->menu_window != None) {
+				XSetWindowBorderWidth(state->display, screen->menu_window, config->border_width);
+				XSetWindowBorder(state->display, screen->menu_window, state->colors[COLOR_BORDER_ACTIVE].pixel);
+			}
+		}
+	}
+
+	if (strcmp(config->wm_name, previous->wm_name)) {
+		x_set_class_hint(state->display, state->root, config->wm_name);
+		ewmh_set_net_wm_name(state);
+	}
+
+	menu_invalidate(state);
+	config_free(previous);
+
+	state_watch(state);
+
+	return True;
+}
+
+/*
+ * Switches every screen back to the desktop it showed before the restart, so
+ * that the windows restored onto it are the ones left mapped.
+ */
+void
+state_restore_desktops(state_t *state)
+{
+	int count, i = 0;
+	long *values;
+	screen_t *screen;
+
+	count = x_get_property(
+			state->display,
+			state->root,
+			state->magnetwm_state,
+			XA_CARDINAL,
+			STATE_MAX_SCREENS,
+			(unsigned char **)&values);
+	if (count <= 0) {
+		return;
+	}
+
+	XDeleteProperty(state->display, state->root, state->magnetwm_state);
+
+	TAILQ_FOREACH(screen, &state->screens, entry) {
+		if (i == count) {
+			break;
+		}
+
+		if ((values[i] >= 0) && (values[i] < screen->desktop_count)) {
+			screen->desktop_index = values[i];
+		}
+
+		i++;
+	}
+
+	XFree(values);
+}
+
+/*
+ * Stores the per-client state that a restart would otherwise lose on the
+ * client windows, and the desktop each screen shows on the root window, for
+ * the next instance to read.
+ */
+void
+state_save(state_t *state)
+{
+	client_t *client;
+	group_t *group;
+	long desktop, index, position;
+	long values[STATE_MAX_SCREENS];
+	screen_t *screen;
+	int count = 0;
+
+	TAILQ_FOREACH(screen, &state->screens, entry) {
+		if (count < STATE_MAX_SCREENS) {
+			values[count++] = screen->desktop_index;
+		}
+
+		for (desktop = 0; desktop < screen->desktop_count; desktop++) {
+			index = 0;
+			TAILQ_FOREACH(group, &screen->desktops[desktop]->groups, entry) {
+				position = 0;
+				TAILQ_FOREACH(client, &group->clients, entry) {
+					client_save_state(state, client, desktop, index, position++);
+				}
+
+				index++;
+			}
+		}
+	}
+
+	XChangeProperty(
+			state->display,
+			state->root,
+			state->magnetwm_state,
+			XA_CARDINAL,
+			32,
+			PropModeReplace,
+			(unsigned char *)values,
+			count);
+}
+
+/*
+ * Adopts the existing windows. Those saved by a previous instance go back to
+ * their desktops, after which their groups and the clients within them are
+ * put back in the saved order.
+ */
+Bool
+state_update_clients(state_t *state)
+{
+	client_t *client;
+	group_t *group;
+	state_order_t *order;
+	unsigned int count, i, restored = 0;
 	Window *windows, root, parent;
 
 	if (!XQueryTree(state->display, state->root, &root, &parent, &windows, &count)) {
 		return False;
 	}
 
+	order = calloc(count + 1, sizeof(state_order_t));
+
 	for (i = 0; i < count; i++) {
 		client = client_init(state, windows[i], True);
-		if (client && client->mapped && !(client->flags & CLIENT_IGNORE) && !(client->flags & CLIENT_HIDDEN)) {
+		if (!client) {
+			continue;
+		}
+
+		if (client_load_state(state, client, &order[restored].group, &order[restored].position)) {
+			order[restored++].client = client;
+		}
+
+		if (client->mapped && !(client->flags & CLIENT_IGNORE) && !(client->flags & CLIENT_HIDDEN)) {
 			client_activate(state, client, False);
 		}
 	}
 
+	qsort(order, restored, sizeof(state_order_t), state_compare_order);
+	for (i = 0; i < restored; i++) {
+		client = order[i].client;
+		group = client->group;
+
+		if ((i == 0) || (order[i - 1].client->group != group)) {
+			TAILQ_REMOVE(&group->desktop->groups, group, entry);
+			TAILQ_INSERT_TAIL(&group->desktop->groups, group, entry);
+		}
+
+		TAILQ_REMOVE(&group->clients, client, entry);
+		TAILQ_INSERT_TAIL(&group->clients, client, entry);
+	}
+
+	free(order);
+
+	if (windows) {
+		XFree(windows);
+	}
+
 	return True;
 }
 
@@ -288,6 +689,7 @@ state_update_screens(state_t *state)
 		}
 
 		screen_update_geometry(state, screen, geometry);
+		screen->refresh_rate = state_crtc_refresh_rate(resources, crtc);
 		screen->wired = True;
 	}
 
@@ -305,7 +707,7 @@ state_update_screens(state_t *state)
 			}
 		}
 
-		screen_free(screen);
+		screen_free(state, screen);
 	}
 
 	screen = screen_find_active(state);
@@ -325,3 +727,44 @@ state_update_screens(state_t *state)
 
 	return True;
 }
+
+/*
+ * Watches the directory of the configuration file rather than the file, so
+ * editors that save by renaming a new copy over it are noticed as well.
+ */
+void
+state_watch(state_t *state)
+{
+#ifdef __linux__
+	char *directory, *separator;
+
+	if (state->watch != -1) {
+		close(state->watch);
+		state->watch = -1;
+	}
+
+	if (!state->config->path) {
+		return;
+	}
+
+	state->watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (state->watch == -1) {
+		return;
+	}
+
+	directory = strdup(state->config->path);
+	separator = strrchr(directory, '/');
+	if (separator == directory) {
+		separator[1] = '\0';
+	} else {
+		separator[0] = '\0';
+	}
+
+	if (inotify_add_watch(state->watch, directory, IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		close(state->watch);
+		state->watch = -1;
+	}
+
+	free(directory);
+#endif /* __linux__ */
+}
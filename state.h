@@ -5,11 +5,14 @@
 #include <X11/Xft/Xft.h>
 #include <X11/Xlib.h>
 
+#include "animation.h"
+#include "drag.h"
 #include "queue.h"
 
 struct config_t;
 struct ewmh_t;
 struct icccm_t;
+struct menu_t;
 struct screen_t;
 
 TAILQ_HEAD(screen_q, screen_t);
@@ -24,6 +27,12 @@ typedef enum cursor_t {
 	CURSOR_NITEMS
 } cursor_t;
 
+typedef enum menu_kind_t {
+	MENU_COMMAND,
+	MENU_EXEC,
+	MENU_NITEMS
+} menu_kind_t;
+
 typedef struct state_t {
 	Colormap colormap;
 	Display *display;
@@ -31,20 +40,32 @@ typedef struct state_t {
 	Window root;
 	int fd;
 	int primary_screen;
+	Atom magnetwm_state;
 	int xrandr_event_base;
 
 	XftColor *colors;
 	XftFont **fonts;
 	Cursor cursors[CURSOR_NITEMS];
 
+	drag_t drag;
+	struct menu_t *menu;
+	struct menu_t *menus[MENU_NITEMS];
+	struct animation_q animations;
+	double next_frame;
+
 	struct config_t *config;
 	struct ewmh_t *ewmh;
 	struct icccm_t *icccm;
 	struct screen_q screens;
+
+	int watch;
 } state_t;
 
 void state_flush(state_t *);
 void state_free(state_t *);
 state_t *state_init(char *);
+void state_process_watch(state_t *);
+Bool state_reload(state_t *);
+void state_save(state_t *);
 
 #endif /* __STATE_H__ */
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "client.h"
+#include "desktop.h"
+#include "group.h"
+#include "screen.h"
+#include "table.h"
+
+#define TABLE_INITIAL_SIZE 64
+
+void table_clear(size_t);
+void table_grow(void);
+
+table_t table = { 0 };
+
+void
+table_add(client_t *client)
+{
+	if (table.free_count > 0) {
+		client->slot = table.free_slots[--table.free_count];
+	} else {
+		if (table.count == table.size) {
+			table_grow();
+		}
+
+		client->slot = table.count++;
+	}
+
+	table.clients[client->slot] = client;
+	table_sync(client);
+}
+
+void
+table_clear(size_t slot)
+{
+	table.clients[slot] = NULL;
+	table.windows[slot] = None;
+	table.flags[slot] = 0;
+	memset(&table.geometry[slot], 0, sizeof(geometry_t));
+	memset(&table.struts[slot], 0, sizeof(table_strut_t));
+	table.groups[slot] = NULL;
+	table.screens[slot] = NULL;
+}
+
+void
+table_free(void)
+{
+	free(table.free_slots);
+	free(table.clients);
+	free(table.windows);
+	free(table.flags);
+	free(table.geometry);
+	free(table.struts);
+	free(table.groups);
+	free(table.screens);
+
+	memset(&table, 0, sizeof(table_t));
+}
+
+void
+table_grow(void)
+{
+	size_t size;
+
+	size = table.size ? table.size * 2 : TABLE_INITIAL_SIZE;
+
+	table.free_slots = realloc(table.free_slots, size * sizeof(size_t));
+	table.clients = realloc(table.clients, size * sizeof(client_t *));
+	table.windows = realloc(table.windows, size * sizeof(Window));
+	table.flags = realloc(table.flags, size * sizeof(unsigned long));
+	table.geometry = realloc(table.geometry, size * sizeof(geometry_t));
+	table.struts = realloc(table.struts, size * sizeof(table_strut_t));
+	table.groups = realloc(table.groups, size * sizeof(group_t *));
+	table.screens = realloc(table.screens, size * sizeof(screen_t *));
+
+	table.size = size;
+}
+
+void
+table_remove(client_t *client)
+{
+	if ((client->slot >= table.count) || (table.clients[client->slot] != client)) {
+		return;
+	}
+
+	table_clear(client->slot);
+
+	if (client->slot == table.count - 1) {
+		table.count--;
+	} else {
+		table.free_slots[table.free_count++] = client->slot;
+	}
+}
+
+void
+table_sync(client_t *client)
+{
+	size_t slot = client->slot;
+
+	if ((slot >= table.count) || (table.clients[slot] != client)) {
+		return;
+	}
+
+	table.windows[slot] = client->window;
+	table.flags[slot] = client->flags;
+	table.geometry[slot] = client->geometry;
+	table.struts[slot].left = client->strut.left;
+	table.struts[slot].right = client->strut.right;
+	table.struts[slot].top = client->strut.top;
+	table.struts[slot].bottom = client->strut.bottom;
+	table.groups[slot] = client->group;
+	table.screens[slot] = client->group ? client->group->desktop->screen : NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef __TABLE_H__
+#define __TABLE_H__
+
+#include <stddef.h>
+
+#include <X11/Xlib.h>
+
+#include "xutils.h"
+
+struct client_t;
+struct group_t;
+struct screen_t;
+
+/*
+ * Structure-of-arrays mirror of the client fields touched by whole-list
+ * scans. Every managed client owns a stable slot for its lifetime; free slots
+ * have a NULL client and zeroed fields, so scans can simply walk [0, count).
+ * The group TAILQs remain the source of truth for ordering; table_sync()
+ * must be called after changing any of the mirrored fields.
+ */
+
+typedef struct table_strut_t {
+	long left;
+	long right;
+	long top;
+	long bottom;
+} table_strut_t;
+
+typedef struct table_t {
+	size_t count;
+	size_t size;
+
+	size_t *free_slots;
+	size_t free_count;
+
+	struct client_t **clients;
+	Window *windows;
+	unsigned long *flags;
+	geometry_t *geometry;
+	table_strut_t *struts;
+	struct group_t **groups;
+	struct screen_t **screens;
+} table_t;
+
+extern table_t table;
+
+void table_add(struct client_t *);
+void table_free(void);
+void table_remove(struct client_t *);
+void table_sync(struct client_t *);
+
+#endif /* __TABLE_H__ */
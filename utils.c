@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "utils.h"
@@ -107,6 +108,23 @@ xexec(char *argstr)
 	(void)execvp(args[0], args);
 }
 
+/* Creates the directory along with any missing parents. */
+void
+xmkdir(char *path)
+{
+	char *p;
+
+	for (p = path + 1; *p; p++) {
+		if (*p == '/') {
+			*p = '\0';
+			mkdir(path, 0700);
+			*p = '/';
+		}
+	}
+
+	mkdir(path, 0700);
+}
+
 void
 xspawn(char *cmd)
 {
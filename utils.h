@@ -18,6 +18,7 @@ long long strtonum(char *, long long, long long, char **);
 
 int xasprintf(char **, char *, ...) __attribute__((__format__ (printf, 2, 3))) __attribute__((__nonnull__ (2)));
 void xexec(char *);
+void xmkdir(char *);
 void xspawn(char *);
 int xvasprintf(char **, char *, va_list) __attribute__((__nonnull__ (2)));
 